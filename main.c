@@ -1,9 +1,19 @@
 #define GL_SILENCE_DEPRECATION
+#ifdef __linux__
+#define _GNU_SOURCE  // pthread_attr_setaffinity_np and CPU_SET
+#endif
+#ifdef __APPLE__
 #include <OpenGL/gl.h>
 #include <GLUT/glut.h>
+#else
+#define GL_GLEXT_PROTOTYPES  // Pixel buffer object entry points
+#include <GL/gl.h>
+#include <GL/glut.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <math.h>
 #include <time.h>
 #include <stdbool.h>
@@ -12,7 +22,26 @@
 #include <libavformat/avformat.h>
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
+#include <errno.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#ifdef __APPLE__
+#include <mach/vm_statistics.h>
+#endif
 #define MAX_THREADS 16
 // Video output related structures
 typedef struct {
@@ -20,11 +49,11 @@ typedef struct {
     AVCodecContext *codec_context;
     AVStream *video_stream;
     AVFrame *frame;
-    uint8_t *frame_buffer;
     struct SwsContext *sws_context;
     int frame_count;
     int total_frames;
     double start_time;
+    int rgb_linesize;  // Bytes per row of the RGB frames passed to encode_frame
 } VideoContext;
 
 // Output mode enum
@@ -33,12 +62,21 @@ typedef enum {
     VIDEO_MODE
 } OutputMode;
 
+// Video frames advance the animation by the same step as real-time mode
+#define VIDEO_TIME_STEP 0.05f
+#define VIDEO_GOP_SIZE 30  // Keyframe interval; checkpoint segments are a multiple of it
+
+#define MAX_RENDITIONS 8
+#define RENDITION_RING_SLOTS 4  // Rendered frames in flight between the render pool and the encoders
+
 // Output configuration
 typedef struct {
     OutputMode mode;
     int duration_seconds;
     int framerate;
     char *output_filename;
+    int rendition_heights[MAX_RENDITIONS];  // -out-mode renditions, empty for a single output
+    int rendition_count;
 } OutputConfig;
 
 // Pattern type enum
@@ -52,22 +90,143 @@ typedef enum {
     VORTEX,
     KALEIDOSCOPE,
     PSYCHEDELIC,
-    CELLULAR
+    CELLULAR,
+    PATTERN_EXPR     // User expression from --pattern-expr
 } PatternType;
 
 // Color mode enum
 typedef enum {
     COLOR_MODE_1,    // Original direct RGB mapping
     COLOR_MODE_2,    // Enhanced color relationships
-    COLOR_MODE_MONO  // Monochrome mode
+    COLOR_MODE_MONO, // Monochrome mode
+    COLOR_MODE_RAINBOW,  // Built-in palettes, looked up by pattern seed
+    COLOR_MODE_FIRE,
+    COLOR_MODE_OCEAN,
+    COLOR_MODE_PALETTE,  // Palette loaded from --palette
+    COLOR_MODE_COUNT
 } ColorMode;
 
+// Palette colour modes map each pattern seed to one entry of a 256- or 1024-entry RGB table.
+// The table rotates with animation time, so only the colour stage depends on the frame time
+// and a frozen pattern field can be recoloured without evaluating it again.
+#define PALETTE_MAX_SIZE 1024
+#define PALETTE_MAX_PATH 400
+#define PALETTE_ROTATION_RATE 0.05f  // Palette turns per unit of animation time
+
 // Randomness mode enum
 typedef enum {
     CLASSIC_RANDOM,    // Original seeding method
-    ENHANCED_RANDOM    // Enhanced random method
+    ENHANCED_RANDOM,   // Enhanced random method
+    LORENZ_RANDOM      // Per-frame terms from a Lorenz attractor trajectory
 } RandomnessMode;
 
+// Per-frame perturbation broadcast to every pixel; the enhanced random formulas take these
+// instead of per-pixel rand() values in Lorenz mode
+typedef struct {
+    float random_factor;  // 0..1
+    float noise;          // -0.2..0.2
+} ChaosTerms;
+
+// Lorenz trajectory of the current seed, kept as a state every LORENZ_CHECKPOINT_STRIDE
+// frames and extended on demand; a frame in between is re-integrated from the checkpoint
+// before it, or from the last frame looked up when that is closer.
+// The attractor advances LORENZ_STEPS_PER_FRAME RK4 steps per VIDEO_TIME_STEP of animation.
+#define LORENZ_DT 0.01
+#define LORENZ_STEPS_PER_FRAME 5
+#define LORENZ_CHECKPOINT_STRIDE 64
+#define LORENZ_MAX_CHECKPOINTS (1 << 20)  // 24 MB, about 67M frames; later frames integrate from the last
+typedef struct {
+    unsigned long seed;
+    double (*checkpoints)[3];  // State at frame k * LORENZ_CHECKPOINT_STRIDE
+    int count, capacity;
+    int cursor_frame;          // Frame of cursor, -1 when unset
+    double cursor[3];
+} LorenzTable;
+
+// Precision tier for the transcendental functions in the pattern and colour stages
+typedef enum {
+    PRECISION_EXACT,     // libm, expressions exactly as written
+    PRECISION_BALANCED,  // libm, float-only rewritten expressions
+    PRECISION_FAST       // Float-only expressions with polynomial approximations
+} PrecisionMode;
+
+// Pattern expressions (--pattern-expr) are parsed into an AST, constant-folded and compiled
+// to a register bytecode. Instructions that do not depend on i run once per row as scalars;
+// the rest run over EXPR_CHUNK pixels at a time as plain array loops the compiler vectorizes.
+#define EXPR_MAX_SOURCE 400
+#define EXPR_MAX_NODES 256
+#define EXPR_MAX_INSNS 128
+#define EXPR_MAX_REGS 32
+#define EXPR_CHUNK 64
+
+// Operators and functions: name, function spelling (NULL for operators), arity,
+// libm form and fast-tier form in terms of the operands x and y
+#define EXPR_OPS(X) \
+    X(NEG,   NULL,    1, -x, -x) \
+    X(NOT,   NULL,    1, (float)~expr_int(x), (float)~expr_int(x)) \
+    X(ADD,   NULL,    2, x + y, x + y) \
+    X(SUB,   NULL,    2, x - y, x - y) \
+    X(MUL,   NULL,    2, x * y, x * y) \
+    X(DIV,   NULL,    2, x / y, x / y) \
+    X(MOD,   NULL,    2, fmodf(x, y), fmodf(x, y)) \
+    X(AND,   NULL,    2, (float)(expr_int(x) & expr_int(y)), (float)(expr_int(x) & expr_int(y))) \
+    X(OR,    NULL,    2, (float)(expr_int(x) | expr_int(y)), (float)(expr_int(x) | expr_int(y))) \
+    X(XOR,   NULL,    2, (float)(expr_int(x) ^ expr_int(y)), (float)(expr_int(x) ^ expr_int(y))) \
+    X(SHL,   NULL,    2, (float)(int)((unsigned)expr_int(x) << (expr_int(y) & 31)), \
+                         (float)(int)((unsigned)expr_int(x) << (expr_int(y) & 31))) \
+    X(SHR,   NULL,    2, (float)(expr_int(x) >> (expr_int(y) & 31)), (float)(expr_int(x) >> (expr_int(y) & 31))) \
+    X(SIN,   "sin",   1, sinf(x), fast_sinf(x)) \
+    X(COS,   "cos",   1, cosf(x), fast_cosf(x)) \
+    X(TAN,   "tan",   1, tanf(x), fast_sinf(x) / fast_cosf(x)) \
+    X(SQRT,  "sqrt",  1, sqrtf(x), sqrtf(x)) \
+    X(ABS,   "abs",   1, fabsf(x), fabsf(x)) \
+    X(FLOOR, "floor", 1, floorf(x), floorf(x)) \
+    X(INT,   "int",   1, (float)expr_int(x), (float)expr_int(x)) \
+    X(EXP,   "exp",   1, expf(x), expf(x)) \
+    X(LOG,   "log",   1, logf(x), logf(x)) \
+    X(ATAN2, "atan2", 2, atan2f(x, y), fast_atan2f(x, y)) \
+    X(HYPOT, "hypot", 2, sqrtf(x * x + y * y), sqrtf(x * x + y * y)) \
+    X(FMOD,  "fmod",  2, fmodf(x, y), fmodf(x, y)) \
+    X(POW,   "pow",   2, powf(x, y), powf(x, y)) \
+    X(MIN,   "min",   2, fminf(x, y), fminf(x, y)) \
+    X(MAX,   "max",   2, fmaxf(x, y), fmaxf(x, y))
+
+#define EXPR_ENUM(name, fn, arity, exact, fast) EOP_##name,
+typedef enum {
+    EOP_CONST, EOP_I, EOP_J, EOP_T, EOP_CX, EOP_CY, EOP_W, EOP_H,
+    EOP_FIRST_OP,
+    EOP_BEFORE_OPS = EOP_FIRST_OP - 1,
+    EXPR_OPS(EXPR_ENUM)
+    EOP_COUNT
+} ExprOp;
+#undef EXPR_ENUM
+
+// AST node; a and b index child nodes, -1 when absent
+typedef struct {
+    int op;
+    int a, b;
+    float value;
+} ExprNode;
+
+// Bytecode instruction; a and b index earlier instructions. Varying instructions depend on i
+// and write register reg; uniform ones only get a register when a varying one reads them.
+typedef struct {
+    int op;
+    int a, b;
+    float value;
+    bool varying;
+    int reg;
+} ExprInsn;
+
+typedef struct {
+    ExprInsn insns[EXPR_MAX_INSNS];
+    int count;
+    int result;  // Instruction holding the pattern value
+} ExprProgram;
+
+ExprProgram pattern_program;                   // Compiled --pattern-expr
+char pattern_expr_source[EXPR_MAX_SOURCE + 1];  // Its source, for farm workers and checkpoints
+
 // Vertex structure
 typedef struct {
     float x, y;           // Position
@@ -80,7 +239,18 @@ bool fill_rects = false;
 unsigned long randseed;
 PatternType pattern_type;
 ColorMode color_mode = COLOR_MODE_1;  // Default to original color mode
+uint8_t palette_lut[PALETTE_MAX_SIZE * 3];  // Table of the current palette mode, built on the main thread
+unsigned int palette_size = 256;  // Power of two, so indexing is a mask
+ColorMode palette_lut_mode = COLOR_MODE_COUNT;     // Mode palette_lut was built for
+uint8_t palette_file_lut[PALETTE_MAX_SIZE * 3];    // --palette, resampled to 256 or 1024 entries
+unsigned int palette_file_size = 0;
+char palette_path[PALETTE_MAX_PATH + 1];           // Its path, for farm workers and checkpoints
+bool field_frozen = false;  // F key: the pattern field holds still while the palette keeps turning
+float frozen_field_time = 0.0f;
 RandomnessMode random_mode = CLASSIC_RANDOM;  // Change default to CLASSIC_RANDOM
+LorenzTable lorenz_table;  // Filled on the main thread only
+PrecisionMode precision_mode = PRECISION_EXACT;
+bool precision_report = false;  // --precision-report
 OutputConfig output_config = {REALTIME_MODE, 0, 0, NULL};  // Default to realtime mode
 
 // FPS counter variables
@@ -91,7 +261,89 @@ int lastTime = 0;
 // Texture related variables
 GLuint texture_id;
 uint8_t* texture_data = NULL;  // RGB texture data
-uint8_t* thread_texture_buffers[MAX_THREADS];  // Per-thread texture buffers
+uint8_t* texture_back = NULL;  // Render-ahead frame being filled while texture_data is displayed
+GLuint pbo_ids[2];             // Double-buffered pixel buffer objects for texture streaming
+int pbo_index = 0;
+uint8_t* thread_texture_buffers[MAX_THREADS];  // Per-thread band buffers, allocated by the worker itself
+size_t thread_texture_sizes[MAX_THREADS];      // Capacity of each band buffer in bytes
+unsigned long* thread_seed_buffers[MAX_THREADS];  // Per-thread pattern seeds for the band
+size_t thread_seed_sizes[MAX_THREADS];            // Capacity of each seed buffer in bytes
+int frame_pitch;                                  // Pixels per row of frame and band buffers
+
+// Pattern field cache: each band's seed buffer is kept together with the field it was
+// evaluated for. A frame over the same field (a colour mode or palette change, or palette
+// rotation over a frozen field) runs only the colour stage over the cached seeds.
+typedef struct {
+    bool valid;
+    unsigned long seed;
+    PatternType pattern_type;
+    unsigned int program_version;  // Which --pattern-expr program, for PATTERN_EXPR
+    RandomnessMode random_mode;
+    PrecisionMode precision_mode;
+    float time_offset;
+    int start_row, end_row, width, height;
+} FieldKey;
+
+typedef struct {
+    long hits;    // Frames coloured entirely from cached fields
+    long misses;  // Frames where at least one band evaluated its pattern
+} FieldCacheStats;
+
+FieldKey field_cache_keys[MAX_THREADS];  // Field held by each slot's seed buffer
+FieldCacheStats field_cache_stats;       // Updated by render_job_wait
+unsigned int pattern_program_version = 0;
+
+static inline bool field_key_equal(const FieldKey* a, const FieldKey* b) {
+    return a->valid && b->valid && a->seed == b->seed && a->pattern_type == b->pattern_type &&
+           a->program_version == b->program_version && a->random_mode == b->random_mode &&
+           a->precision_mode == b->precision_mode && a->time_offset == b->time_offset &&
+           a->start_row == b->start_row && a->end_row == b->end_row &&
+           a->width == b->width && a->height == b->height;
+}
+
+// Frame buffer pool: frames and band buffers are 64-byte aligned with rows padded to a
+// multiple of 64 pixels, large ones are backed by huge pages where the system offers them,
+// and freed buffers go to a free list for the next frame or job instead of back to the system.
+// Blocks are kept per NUMA node: a pinned worker only reuses blocks first touched on its own
+// node, and never shares a huge page with a worker on another node.
+#define POOL_ALIGN 64
+#define POOL_HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define POOL_MAX_BLOCKS 128
+
+typedef enum {
+    HUGE_PAGES_OFF,       // Normal pages only
+    HUGE_PAGES_AUTO,      // Transparent huge pages on Linux, superpages on macOS where offered
+    HUGE_PAGES_EXPLICIT   // Reserved hugetlbfs pages (MAP_HUGETLB), then as auto
+} HugePageMode;
+
+typedef enum {
+    POOL_PAGES_HEAP,      // posix_memalign, for buffers smaller than a huge page
+    POOL_PAGES_NORMAL,    // Mapped with normal pages
+    POOL_PAGES_HUGE       // Mapped with huge pages requested
+} PoolPages;
+
+typedef struct {
+    void* ptr;
+    size_t size;
+    PoolPages pages;
+    bool in_use;
+    int node;             // NUMA node of the pinned worker that allocated it, -1 for other threads
+} PoolBlock;
+
+typedef struct {
+    long allocations;     // Blocks obtained from the system
+    long reuses;          // Requests served from the free list
+    long huge_fallbacks;  // Huge page requests that got normal pages
+    size_t bytes;         // Bytes currently held by the pool
+    size_t huge_bytes;    // Of which mapped with huge pages requested
+} PoolStats;
+
+HugePageMode huge_page_mode = HUGE_PAGES_AUTO;  // --huge-pages
+PoolBlock pool_blocks[POOL_MAX_BLOCKS];
+int pool_block_count = 0;
+PoolStats pool_stats;
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+__thread int pool_thread_node = -1;  // Set by pinned render workers
 
 // OpenGL buffer objects
 GLuint VBO, IBO;
@@ -106,20 +358,216 @@ int num_threads = 8;  // Default to 8 threads
 pthread_mutex_t vertex_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t texture_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// CPU placement variables
+#define MAX_CPUS 1024
+bool pin_workers = false;        // Pin render workers to CPUs (--pin)
+int pin_cpu_list[MAX_CPUS];      // Explicit CPUs from --pin, empty for topology-derived placement
+int pin_cpu_count = 0;
+int worker_cpu[MAX_THREADS];     // CPU each worker slot runs on, -1 when unpinned
+int cpu_node[MAX_CPUS];          // NUMA node of each CPU
+int numa_node_count = 1;
+
+// Seed exploration (--explore): score many seeds on thumbnails and keep the best
+#define EXPLORE_THUMB_WIDTH 160  // Thumbnails sample every (Width / 160)th pixel of the full frame
+#define EXPLORE_TIME 1.0f        // Animation time the seeds are judged at
+#define EXPLORE_BATCH 16         // Seeds a worker claims at a time
+int explore_seeds = 0;           // --explore, 0 when not exploring
+int explore_top = 16;            // --top
+
+// Benchmark mode variables
+int bench_frames = 0;            // Frames per benchmark run, 0 when not benchmarking
+bool staged_bands = true;        // Workers colour into their own band buffer, then merge
+
+// Order in which a worker evaluates its band (--traversal). Tiled evaluation runs the pattern
+// and colour stages back to back on TILE_SIZE x TILE_SIZE tiles visited in Z-order, so a
+// tile's seeds are still in L1/L2 when they are coloured and neighbouring tiles share lines.
+#define TILE_SIZE 64
+typedef enum {
+    TRAVERSAL_ROWS,   // Whole band through the pattern stage, then the colour stage
+    TRAVERSAL_TILED
+} TraversalMode;
+
+TraversalMode traversal_mode = TRAVERSAL_ROWS;
+
+// Hardware performance counters (benchmark mode, Linux perf_event_open)
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_L1D_MISSES,  // L1D read misses, i.e. loads served by L2 or beyond
+    NUM_COUNTERS
+} CounterId;
+
+typedef struct {
+    uint64_t values[NUM_COUNTERS];
+} CounterSample;
+
+bool use_counters = false;                 // --counters
+bool counter_available[NUM_COUNTERS];      // Which events this machine lets us open
+CounterSample worker_counters[MAX_THREADS];  // Accumulated per worker slot
+
+// Progressive refinement variables (real-time mode only)
+#define PROGRESSIVE_START_STEP 8       // First pass evaluates one sample per 8x8 block
+int progressive_step = 0;              // Sample spacing of the next refinement pass, 0 when idle
+double progressive_request_time = 0.0; // When the interactive change that started refinement happened
+
+// Stage tracing. Build with 'make TRACE=1' to compile it in; otherwise the TRACE_* macros
+// expand to nothing. Each thread slot owns a single-producer ring of begin/end events that
+// is only read back once the threads writing it have been joined. Spans that outlive the
+// enclosing one on their thread, such as a render-ahead frame, are async events paired by id.
+#ifdef ARTMAKER_TRACE
+#define TRACE_MAX_SLOTS (MAX_THREADS + 1 + MAX_RENDITIONS)  // Main thread, render workers, rendition encoders
+#define TRACE_RING_SIZE 16384              // Events per slot, oldest overwritten first
+
+typedef struct {
+    const char* name;
+    uint64_t timestamp_ns;
+    char phase;   // 'B' or 'E', 'b' or 'e' for async spans
+    unsigned id;  // Pairs an async span's begin and end
+} TraceEvent;
+
+typedef struct {
+    TraceEvent events[TRACE_RING_SIZE];
+    uint64_t head;  // Total events ever written to this ring
+} TraceRing;
+
+bool trace_enabled = false;
+uint64_t trace_start_ns = 0;
+TraceRing* trace_rings[TRACE_MAX_SLOTS];
+__thread int trace_slot = 0;
+
+#define TRACE_BEGIN(name) trace_event(name, 'B', 0)
+#define TRACE_END(name) trace_event(name, 'E', 0)
+#define TRACE_ASYNC_BEGIN(name, id) trace_event(name, 'b', id)
+#define TRACE_ASYNC_END(name, id) trace_event(name, 'e', id)
+#define TRACE_SET_SLOT(slot) (trace_slot = (slot))
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_ASYNC_BEGIN(name, id) ((void)0)
+#define TRACE_ASYNC_END(name, id) ((void)0)
+#define TRACE_SET_SLOT(slot) ((void)0)
+#endif
+char* trace_filename = NULL;  // --trace output file
+
+// Startup phase report (--timings): each phase is marked once, the first time it completes,
+// and the marks are printed relative to process start
+#define MAX_TIMING_MARKS 16
+typedef struct {
+    const char* name;
+    double time;
+} TimingMark;
+
+bool show_timings = false;
+double process_start_time;
+TimingMark timing_marks[MAX_TIMING_MARKS];
+int timing_mark_count = 0;
+pthread_mutex_t timing_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Frame farm: a coordinator splits an -out-mode job into frame ranges and hands them to
+// worker processes over TCP or Unix sockets. Workers encode each range into a standalone
+// segment and send it back; the coordinator re-queues the range of any worker that drops
+// and finally remuxes the segments into one file without re-encoding.
+#define FARM_DEFAULT_CHUNK 60      // Frames per range
+#define FARM_MAX_CONNECTIONS 64
+#define FARM_MAX_ATTEMPTS 3        // Dispatches of one range before the render is abandoned
+#define FARM_JOB_TIMEOUT 600.0     // Seconds before a silent worker's range is re-queued
+
+typedef enum {
+    FARM_JOB_PENDING,
+    FARM_JOB_ASSIGNED,
+    FARM_JOB_DONE
+} FarmJobState;
+
+typedef struct {
+    int first_frame;
+    int frame_count;
+    FarmJobState state;
+    int attempts;
+    char segment_path[512];
+} FarmJob;
+
+typedef struct {
+    int fd;                  // -1 for an unused slot
+    int job;                 // Range assigned to this worker, -1 when idle
+    bool ready;              // Worker sent READY and waits for a range
+    char input[512];         // Partial control line
+    int input_len;
+    FILE* segment;           // Segment being received, NULL outside a transfer
+    size_t segment_left;     // Payload bytes still to come
+    double assigned_time;
+} FarmConnection;
+
+char* farm_coordinator_address = NULL;       // --coordinator
+char* farm_worker_address = NULL;            // --worker
+int farm_local_workers = 0;                  // --farm-workers
+int farm_chunk_frames = FARM_DEFAULT_CHUNK;  // --chunk
+
+// Checkpointed video renders: the video is encoded as GOP-aligned segments in
+// <output>.checkpoint/, with a state file updated after each one so --resume can continue
+// from the last finished segment and remux the result without re-encoding
+int checkpoint_frames = 0;       // --checkpoint, frames per segment (0 disables)
+bool resume_render = false;      // --resume
+
+// CPU budget for video mode (--cpu-budget): cores are split between the render pool and the
+// encoder's own threads, and the render pool is rebalanced every GOP toward the slower stage
+int cpu_budget = 0;              // 0 leaves -t and the encoder's thread defaults alone
+int encoder_threads = 0;         // Codec thread_count, 0 lets libx264 choose
+
+// Where video mode spends its time, for the per-stage throughput report
+typedef struct {
+    double render_seconds;       // Render pool busy time
+    double encode_seconds;       // Main thread in colour conversion and the encoder
+    double wait_seconds;         // Main thread blocked on the render pool
+    int frames;
+} VideoStageStats;
+
+VideoStageStats video_stage_stats;
+
 // Thread work structure
 typedef struct {
     int start_row;
     int end_row;
     unsigned long seed;
     PatternType pattern_type;
-    float time_offset;
+    float time_offset;        // Animation time of the pattern field
+    float colour_time;        // Animation time of the colour stage, ahead of it while frozen
+    bool field_hit;           // The band was coloured from the field cache
+    const bool* cancel;       // The job's cancel flag, NULL for progressive passes
+    bool cancelled;           // Stopped early; the band is incomplete
     uint8_t* texture_buffer;  // Local texture buffer for this thread
+    uint8_t* frame;           // Frame the finished band is written into
+    ChaosTerms chaos;         // Lorenz mode terms for this frame
+    int step;                 // Sample spacing for progressive passes
+    int slot;                 // Worker index, selects the band buffer and CPU
+    int node;                 // NUMA node of the slot's CPU at job start, -1 when unpinned
+    double finish_time;       // When the band was done
 } ThreadWork;
 
+// A frame being rendered by the worker threads
+typedef struct {
+    pthread_t threads[MAX_THREADS];
+    ThreadWork thread_work[MAX_THREADS];
+    int thread_count;
+    bool active;              // Threads started and not yet joined
+    bool cancel;              // Set by render_job_cancel; workers stop at the next row
+    double start_time;
+    double seconds;           // Start to last band finished, set by render_job_wait
+    unsigned trace_id;        // Pairs the frame's async render_frame events
+} RenderJob;
+
+unsigned render_job_count = 0;  // Frames started, for the trace ids
+
+RenderJob render_ahead;       // Real-time mode: next frame, rendered while the current one is shown
+float display_time_offset = 0.0f;  // Real-time mode: animation time of the latest frame started
+
 // Function to parse random mode from string
 RandomnessMode parse_random_mode(const char* mode_str) {
     if (strcmp(mode_str, "classic") == 0) return CLASSIC_RANDOM;
     if (strcmp(mode_str, "enhanced") == 0) return ENHANCED_RANDOM;
+    if (strcmp(mode_str, "lorenz") == 0) return LORENZ_RANDOM;
     
     printf("Invalid random mode '%s'. Using default (classic).\n", mode_str);
     return CLASSIC_RANDOM;
@@ -130,11 +578,44 @@ ColorMode parse_color_mode(const char* mode_str) {
     if (strcmp(mode_str, "rgb") == 0) return COLOR_MODE_1;
     if (strcmp(mode_str, "enhanced") == 0) return COLOR_MODE_2;
     if (strcmp(mode_str, "mono") == 0) return COLOR_MODE_MONO;
+    if (strcmp(mode_str, "rainbow") == 0) return COLOR_MODE_RAINBOW;
+    if (strcmp(mode_str, "fire") == 0) return COLOR_MODE_FIRE;
+    if (strcmp(mode_str, "ocean") == 0) return COLOR_MODE_OCEAN;
     
     printf("Invalid color mode '%s'. Using default (rgb).\n", mode_str);
     return COLOR_MODE_1;
 }
 
+// Function to parse precision tier from string
+PrecisionMode parse_precision_mode(const char* mode_str) {
+    if (strcmp(mode_str, "exact") == 0) return PRECISION_EXACT;
+    if (strcmp(mode_str, "balanced") == 0) return PRECISION_BALANCED;
+    if (strcmp(mode_str, "fast") == 0) return PRECISION_FAST;
+    
+    printf("Invalid precision '%s'. Using default (exact).\n", mode_str);
+    return PRECISION_EXACT;
+}
+
+// Parse a comma-separated list of rendition heights ("1080,720p,360"), returning the count
+int parse_rendition_list(const char* list, int* heights) {
+    int count = 0;
+    const char* p = list;
+    while (*p && count < MAX_RENDITIONS) {
+        char* end;
+        long height = strtol(p, &end, 10);
+        if (end == p) break;
+        if (height >= 16) {
+            heights[count++] = (int)height;
+        } else {
+            printf("Ignoring rendition height %ld.\n", height);
+        }
+        p = end;
+        if (*p == 'p') p++;
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
 // Function to parse pattern type from string
 PatternType parse_pattern_type(const char* pattern_str) {
     if (strcmp(pattern_str, "original") == 0) return ORIGINAL;
@@ -152,728 +633,4124 @@ PatternType parse_pattern_type(const char* pattern_str) {
     return ORIGINAL;
 }
 
+// Short names matching the command-line spellings
+const char* pattern_type_name(PatternType type) {
+    switch(type) {
+        case PATTERN_EXPR: return "expr";
+        case ORIGINAL: return "original";
+        case POLAR: return "polar";
+        case TRIGONOMETRIC: return "trig";
+        case FRACTAL: return "fractal";
+        case WAVE_INTERFERENCE: return "wave";
+        case WAVE2: return "wave2";
+        case VORTEX: return "vortex";
+        case KALEIDOSCOPE: return "kaleidoscope";
+        case PSYCHEDELIC: return "psychedelic";
+        case CELLULAR: return "cellular";
+        default: return "unknown";
+    }
+}
+
+TraversalMode parse_traversal_mode(const char* mode_str) {
+    if (strcmp(mode_str, "rows") == 0) return TRAVERSAL_ROWS;
+    if (strcmp(mode_str, "tiled") == 0) return TRAVERSAL_TILED;
+    
+    printf("Invalid traversal '%s'. Using default (rows).\n", mode_str);
+    return TRAVERSAL_ROWS;
+}
+
+const char* traversal_mode_name(TraversalMode mode) {
+    return mode == TRAVERSAL_TILED ? "tiled" : "rows";
+}
+
+const char* precision_mode_name(PrecisionMode mode) {
+    switch(mode) {
+        case PRECISION_EXACT: return "exact";
+        case PRECISION_BALANCED: return "balanced";
+        case PRECISION_FAST: return "fast";
+        default: return "unknown";
+    }
+}
+
+const char* random_mode_name(RandomnessMode mode) {
+    switch(mode) {
+        case CLASSIC_RANDOM: return "classic";
+        case ENHANCED_RANDOM: return "enhanced";
+        case LORENZ_RANDOM: return "lorenz";
+        default: return "unknown";
+    }
+}
+
+const char* color_mode_name(ColorMode mode) {
+    switch(mode) {
+        case COLOR_MODE_1: return "rgb";
+        case COLOR_MODE_2: return "enhanced";
+        case COLOR_MODE_MONO: return "mono";
+        case COLOR_MODE_RAINBOW: return "rainbow";
+        case COLOR_MODE_FIRE: return "fire";
+        case COLOR_MODE_OCEAN: return "ocean";
+        case COLOR_MODE_PALETTE: return "palette";
+        default: return "unknown";
+    }
+}
+
 void print_usage(const char* program_name) {
     printf("USAGE: %s <width> <height> <pixelsize> [options]\n\n", program_name);
     printf("Options:\n");
     printf("  -p, --pattern <type>   Set pattern type (original, polar, trig, fractal, wave, wave2, symmetry,\n");
     printf("                         vortex, kaleidoscope, cellular, psychedelic)\n");
+    printf("  --pattern-expr <expr>  Use a custom pattern expression, or @name for a built-in one\n");
     printf("  --fill-rects           Fill rectangles instead of outlines\n");
     printf("  -t, --threads <num>    Set number of threads (1-%d, default: 4)\n", MAX_THREADS);
-    printf("  -out-mode <sec> <fps>  Generate video output instead of real-time display\n");
+    printf("  -out-mode <sec> <fps> [heights]  Generate video output instead of real-time display;\n");
+    printf("                         heights (e.g. 1080,720,360) renders once and encodes each rendition\n");
     printf("  -o, --output <file>    Specify output video filename (default: auto-generated)\n");
-    printf("  -r, --random <mode>    Set random mode (classic, enhanced)\n");
-    printf("  -c, --color <mode>     Set color mode (rgb, enhanced, mono)\n");
+    printf("  -r, --random <mode>    Set random mode (classic, enhanced, lorenz)\n");
+    printf("  -c, --color <mode>     Set color mode (rgb, enhanced, mono, rainbow, fire, ocean)\n");
+    printf("  --palette <file>       Colour from a palette file of 'r g b' lines (up to %d entries)\n", PALETTE_MAX_SIZE);
+    printf("  --precision <tier>     Set math precision (exact, balanced, fast)\n");
+    printf("  --traversal <order>    Band evaluation order (rows, tiled: %dx%d Z-order tiles)\n", TILE_SIZE, TILE_SIZE);
+    printf("  --precision-report     Report per-channel error of each tier against exact and exit\n");
+    printf("  --pin <cpus|auto>      Pin render threads to CPUs (e.g. 0,2,4-7) or a NUMA-aware set\n");
+    printf("  --explore <n>          Score n random seeds on thumbnails and write the best to a contact sheet\n");
+    printf("  --top <k>              Seeds kept by --explore (default: 16); -o names the .ppm sheet\n");
+    printf("  --bench <frames>       Benchmark thread scaling, pinned vs unpinned, and exit\n");
+    printf("  --counters             With --bench, report IPC and misses per pixel for every pattern/color\n");
+    printf("  --timings              Report startup phases up to the first frame and first packet\n");
+    printf("  --trace <file>         Write a Chrome trace of frame stages (needs 'make TRACE=1')\n");
+    printf("  --huge-pages <mode>    Frame buffer pages: auto (default), explicit (MAP_HUGETLB) or off\n");
+    printf("  --cpu-budget <cores>   Split cores between render threads and the encoder (overrides -t)\n");
+    printf("  --checkpoint <frames>  Encode -out-mode video in resumable segments of about this many frames\n");
+    printf("  --resume               Continue a checkpointed render of the same output file\n");
+    printf("  --coordinator <addr>   Farm an -out-mode render out to workers (unix:/path or tcp:host:port)\n");
+    printf("  --farm-workers <n>     With --coordinator, spawn n local worker processes\n");
+    printf("  --chunk <frames>       Frames per farm range (default: %d)\n", FARM_DEFAULT_CHUNK);
+    printf("  --worker <addr>        Run as a farm worker for the coordinator at addr\n");
     printf("\nControls (Real-time mode only):\n");
     printf("  ESC                    Exit program\n");
     printf("  Space                  Generate new random seed\n");
     printf("  0-9                    Change pattern type\n");
-    printf("  C                      Cycle through color modes\n");
+    printf("  C                      Cycle through color modes and palettes\n");
+    printf("  F                      Freeze the pattern field, keep rotating the palette\n");
     printf("  R                      Cycle through randomness modes\n");
     printf("  +/-                    Increase/decrease number of threads\n");
     printf("\nExample: %s 800 600 10 -p psychedelic --fill-rects -t 8\n", program_name);
     printf("         %s 800 600 10 -p wave -out-mode 5 30 -o output.mp4 -r lorenz -c rainbow\n", program_name);
 }
 
-// OpenGL initialization and rendering functions
-void initGL(int width, int height, int argc, char** argv) {
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowSize(width, height);
-    glutCreateWindow("Artmaker");
-    
-    // Set up orthographic projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, width, height, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+// Function to get current time in seconds
+double get_current_time() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Record that a startup phase finished now, unless it already has
+void timing_mark(const char* name) {
+    if (!show_timings) return;
+    double now = get_current_time();
+    pthread_mutex_lock(&timing_mutex);
+    bool seen = false;
+    for (int k = 0; k < timing_mark_count; k++) {
+        seen = seen || strcmp(timing_marks[k].name, name) == 0;
+    }
+    if (!seen && timing_mark_count < MAX_TIMING_MARKS) {
+        timing_marks[timing_mark_count].name = name;
+        timing_marks[timing_mark_count].time = now;
+        timing_mark_count++;
+    }
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+// Print the marks in the order they happened, with the time since the previous one
+void print_timings() {
+    if (!show_timings || timing_mark_count == 0) return;
+    pthread_mutex_lock(&timing_mutex);
+    for (int a = 1; a < timing_mark_count; a++) {
+        for (int b = a; b > 0 && timing_marks[b].time < timing_marks[b - 1].time; b--) {
+            TimingMark swap = timing_marks[b];
+            timing_marks[b] = timing_marks[b - 1];
+            timing_marks[b - 1] = swap;
+        }
+    }
+    printf("\nStartup timings (ms since process start):\n");
+    double previous = process_start_time;
+    for (int k = 0; k < timing_mark_count; k++) {
+        printf("  %-28s %9.2f  (+%.2f)\n", timing_marks[k].name,
+               (timing_marks[k].time - process_start_time) * 1000.0, (timing_marks[k].time - previous) * 1000.0);
+        previous = timing_marks[k].time;
+    }
+    pthread_mutex_unlock(&timing_mutex);
+    show_timings = false;  // Once per run
+}
+
+#ifdef ARTMAKER_TRACE
+uint64_t trace_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Record a begin/end event in the calling thread's ring
+void trace_event(const char* name, char phase, unsigned id) {
+    if (!trace_enabled) return;
     
-    // Enable texturing
-    glEnable(GL_TEXTURE_2D);
+    TraceRing* ring = trace_rings[trace_slot];
+    if (!ring) {
+        ring = (TraceRing*)malloc(sizeof(TraceRing));
+        ring->head = 0;
+        trace_rings[trace_slot] = ring;
+    }
     
-    // Create and initialize texture
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    uint64_t head = ring->head;
+    TraceEvent* event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->name = name;
+    event->timestamp_ns = trace_now_ns();
+    event->phase = phase;
+    event->id = id;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_start() {
+    trace_start_ns = trace_now_ns();
+    trace_enabled = true;
+}
+
+// Dump every ring as Chrome/Perfetto trace-event JSON
+void trace_write(const char* filename) {
+    trace_enabled = false;
     
-    // Allocate texture data buffer
-    texture_data = (uint8_t*)malloc(width * height * 3);  // RGB format
-    memset(texture_data, 0, width * height * 3);
+    FILE* f = fopen(filename, "w");
+    if (!f) {
+        fprintf(stderr, "Could not open trace file '%s'\n", filename);
+        return;
+    }
     
-    // Allocate per-thread texture buffers - allocate full height for each thread to be safe
-    for (int i = 0; i < MAX_THREADS; i++) {
-        thread_texture_buffers[i] = (uint8_t*)malloc(width * height * 3);
-        memset(thread_texture_buffers[i], 0, width * height * 3);
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    size_t total = 0;
+    for (int slot = 0; slot < TRACE_MAX_SLOTS; slot++) {
+        TraceRing* ring = trace_rings[slot];
+        if (!ring) continue;
+        
+        char thread_name[32];
+        if (slot == 0) snprintf(thread_name, sizeof(thread_name), "main");
+        else if (slot <= MAX_THREADS) snprintf(thread_name, sizeof(thread_name), "worker %d", slot - 1);
+        else snprintf(thread_name, sizeof(thread_name), "aux %d", slot - MAX_THREADS - 1);
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", slot, thread_name);
+        first = false;
+        
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t oldest = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (uint64_t e = oldest; e < head; e++) {
+            TraceEvent* event = &ring->events[e & (TRACE_RING_SIZE - 1)];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    event->name, event->phase,
+                    (event->timestamp_ns - trace_start_ns) / 1000.0, slot);
+            if (event->phase == 'b' || event->phase == 'e') {
+                fprintf(f, ",\"cat\":\"frame\",\"id\":%u", event->id);
+            }
+            fprintf(f, "}");
+            total++;
+        }
     }
+    fprintf(f, "\n]}\n");
+    fclose(f);
     
-    // Initialize texture with black
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, texture_data);
+    printf("Trace written: %s (%zu events)\n", filename, total);
 }
+#endif
 
-void clearScreen() {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+// Open the hardware counters for the calling thread as one group led by the cycle counter.
+// Events the machine does not support are left at -1 and skipped.
+bool counters_open(int fds[NUM_COUNTERS]) {
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        fds[c] = -1;
+    }
+#ifdef __linux__
+    static const uint32_t types[NUM_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HW_CACHE
+    };
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+    
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        if (c > 0 && !counter_available[c]) continue;
+        
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[c];
+        attr.config = configs[c];
+        attr.disabled = (c == 0);  // The leader starts the whole group
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        
+        fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, c == 0 ? -1 : fds[0], 0);
+        if (fds[c] < 0 && c == 0) return false;
+    }
+    
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
 }
 
-void addQuad(Vertex* vertices, int* vertex_count, 
-             float x, float y, float width, float height,
-             float r, float g, float b, float a) {
-    // Add four vertices for the quad
-    vertices[*vertex_count].x = x;
-    vertices[*vertex_count].y = y;
-    vertices[*vertex_count].r = r;
-    vertices[*vertex_count].g = g;
-    vertices[*vertex_count].b = b;
-    vertices[*vertex_count].a = a;
-    (*vertex_count)++;
+// Stop the group, add its counts to total and close it
+void counters_close(int fds[NUM_COUNTERS], CounterSample* total) {
+#ifdef __linux__
+    ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        if (fds[c] < 0) continue;
+        uint64_t value = 0;
+        if (read(fds[c], &value, sizeof(value)) == sizeof(value)) {
+            total->values[c] += value;
+        }
+        close(fds[c]);
+    }
+#endif
+}
 
-    vertices[*vertex_count].x = x + width;
-    vertices[*vertex_count].y = y;
-    vertices[*vertex_count].r = r;
-    vertices[*vertex_count].g = g;
-    vertices[*vertex_count].b = b;
-    vertices[*vertex_count].a = a;
-    (*vertex_count)++;
+// Check which counters can be opened here. Containers and locked-down kernels commonly
+// refuse perf_event_open, in which case benchmarks fall back to wall-clock numbers only.
+bool counters_probe() {
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        counter_available[c] = true;
+    }
+#ifdef __linux__
+    int fds[NUM_COUNTERS];
+    if (!counters_open(fds)) {
+        printf("Hardware counters unavailable (%s); check /proc/sys/kernel/perf_event_paranoid. "
+               "Reporting wall-clock numbers only.\n", strerror(errno));
+        memset(counter_available, 0, sizeof(counter_available));
+        return false;
+    }
+    static const char* names[NUM_COUNTERS] = { "cycles", "instructions", "cache-misses", "branch-misses",
+                                               "dTLB-load-misses", "L1-dcache-load-misses" };
+    for (int c = 1; c < NUM_COUNTERS; c++) {
+        counter_available[c] = fds[c] >= 0;
+        if (!counter_available[c]) {
+            printf("Hardware counter '%s' unavailable; it will be reported as n/a.\n", names[c]);
+        }
+    }
+    CounterSample discard;
+    counters_close(fds, &discard);
+    return true;
+#else
+    printf("Hardware counters are only supported on Linux; reporting wall-clock numbers only.\n");
+    memset(counter_available, 0, sizeof(counter_available));
+    return false;
+#endif
+}
 
-    vertices[*vertex_count].x = x + width;
-    vertices[*vertex_count].y = y + height;
-    vertices[*vertex_count].r = r;
-    vertices[*vertex_count].g = g;
-    vertices[*vertex_count].b = b;
-    vertices[*vertex_count].a = a;
-    (*vertex_count)++;
+// Parse a CPU list such as "0,2,4-7" into cpus, returning the number of entries
+int parse_cpu_list(const char* list, int* cpus, int max_cpus) {
+    int count = 0;
+    const char* p = list;
+    while (*p && count < max_cpus) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && count < max_cpus; cpu++) {
+            if (cpu >= 0 && cpu < MAX_CPUS) cpus[count++] = (int)cpu;
+        }
+        while (*p == ',' || *p == ' ' || *p == '\n') p++;
+    }
+    return count;
+}
 
-    vertices[*vertex_count].x = x;
-    vertices[*vertex_count].y = y + height;
-    vertices[*vertex_count].r = r;
-    vertices[*vertex_count].g = g;
-    vertices[*vertex_count].b = b;
-    vertices[*vertex_count].a = a;
-    (*vertex_count)++;
+// Read the NUMA node of every CPU from sysfs; everything is node 0 when unavailable
+void detect_cpu_topology() {
+    memset(cpu_node, 0, sizeof(cpu_node));
+    numa_node_count = 1;
+#ifdef __linux__
+    for (int node = 0; node < 64; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        
+        char list[4096];
+        if (fgets(list, sizeof(list), f)) {
+            int cpus[MAX_CPUS];
+            int count = parse_cpu_list(list, cpus, MAX_CPUS);
+            for (int c = 0; c < count; c++) {
+                cpu_node[cpus[c]] = node;
+            }
+            if (count > 0 && node + 1 > numa_node_count) numa_node_count = node + 1;
+        }
+        fclose(f);
+    }
+#endif
 }
 
-// Function to calculate pattern seed with time offset
-unsigned long calculate_pattern_seed(int i, int j, PatternType pattern_type, float time_offset, int Width, int Height, unsigned long base_seed) {
-    int centerX = Width / 2;
-    int centerY = Height / 2;
+// Decide which CPU each worker slot runs on for the current thread count. Explicit lists are
+// used round-robin; the topology-derived set gives each node a contiguous run of workers so
+// neighbouring bands of texture_data stay on the same node.
+void assign_worker_cpus() {
+    for (int t = 0; t < MAX_THREADS; t++) {
+        worker_cpu[t] = -1;
+    }
+    if (!pin_workers) return;
     
-    if (random_mode == ENHANCED_RANDOM) {
-        // Add some global randomness factors
-        float random_factor = (float)rand() / RAND_MAX;
-        float noise = (random_factor * 2.0f - 1.0f) * 0.2f; // Random noise between -0.2 and 0.2
+    if (pin_cpu_count > 0) {
+        for (int t = 0; t < num_threads; t++) {
+            worker_cpu[t] = pin_cpu_list[t % pin_cpu_count];
+        }
+        return;
+    }
+    
+    int online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) online = 1;
+    if (online > MAX_CPUS) online = MAX_CPUS;
+    
+    for (int t = 0; t < num_threads; t++) {
+        int node = t * numa_node_count / num_threads;
+        int first_worker = (node * num_threads + numa_node_count - 1) / numa_node_count;
+        int index = t - first_worker;
         
-        switch(pattern_type) {
-            case ORIGINAL:
-                return base_seed | ((i*j & (int)(i*cos(time_offset + noise)*j)) ^ ((int)(random_factor * 1000)));
-                
-            case POLAR: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float distance = sqrtf(dx*dx + dy*dy) / (sqrtf(Width*Width + Height*Height) * 0.5f);
-                float angle = atan2f(dy, dx);
-                float pattern = (sinf(distance * 10.0f + time_offset) * 0.5f + 0.5f) * 
-                              (sinf(angle * 4.0f + time_offset + noise) * 0.5f + 0.5f);
-                return base_seed | ((int)(pattern * 1000) ^ ((int)(random_factor * 1000)));
+        // Pick the index-th CPU of this node, wrapping when the node has fewer CPUs than workers
+        int node_cpus = 0;
+        for (int cpu = 0; cpu < online; cpu++) {
+            if (cpu_node[cpu] == node) node_cpus++;
+        }
+        if (node_cpus == 0) {
+            worker_cpu[t] = t % online;
+            continue;
+        }
+        int wanted = index % node_cpus;
+        for (int cpu = 0; cpu < online; cpu++) {
+            if (cpu_node[cpu] == node && wanted-- == 0) {
+                worker_cpu[t] = cpu;
+                break;
             }
-            
-            case TRIGONOMETRIC: {
-                float freq_mod = 0.05f * (1.0f + noise);
-                return base_seed | ((int)(sinf(i*freq_mod + time_offset + random_factor)*100) * 
-                                  (int)(cosf(j*freq_mod - time_offset + random_factor)*100));
+        }
+    }
+}
+
+void print_worker_placement() {
+    if (!pin_workers) {
+        printf("Worker placement: unpinned (%d NUMA node%s)\n",
+               numa_node_count, numa_node_count == 1 ? "" : "s");
+        return;
+    }
+    printf("Worker placement (%d NUMA node%s):\n", numa_node_count, numa_node_count == 1 ? "" : "s");
+    for (int t = 0; t < num_threads; t++) {
+        printf("  worker %2d -> CPU %3d (node %d)\n", t, worker_cpu[t], cpu_node[worker_cpu[t]]);
+    }
+}
+
+// Start a render worker, pinned to its CPU when placement is enabled so that everything it
+// first-touches is allocated on its local node
+int create_worker_thread(pthread_t* thread, int slot, void* (*fn)(void*), void* arg) {
+#ifdef __linux__
+    if (worker_cpu[slot] >= 0) {
+        pthread_attr_t attr;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker_cpu[slot], &cpus);
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        int ret = pthread_create(thread, &attr, fn, arg);
+        pthread_attr_destroy(&attr);
+        return ret;
+    }
+#endif
+    return pthread_create(thread, NULL, fn, arg);
+}
+
+// Map size bytes (a multiple of the huge page size), with huge pages if the mode allows.
+// Returns NULL on failure.
+void* pool_map(size_t size, PoolPages* pages) {
+    void* ptr;
+#ifdef __linux__
+    if (huge_page_mode == HUGE_PAGES_EXPLICIT) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            *pages = POOL_PAGES_HUGE;
+            return ptr;
+        }
+    }
+    if (huge_page_mode != HUGE_PAGES_OFF) {
+        // Map an extra huge page and trim both ends so the block starts on a huge page
+        // boundary, then ask for transparent huge pages
+        size_t span = size + POOL_HUGE_PAGE_SIZE;
+        uint8_t* raw = (uint8_t*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != (uint8_t*)MAP_FAILED) {
+            uint8_t* aligned = (uint8_t*)(((uintptr_t)raw + POOL_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(POOL_HUGE_PAGE_SIZE - 1));
+            if (aligned > raw) munmap(raw, aligned - raw);
+            if (raw + span > aligned + size) munmap(aligned + size, (raw + span) - (aligned + size));
+            if (madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+                *pages = POOL_PAGES_HUGE;
+                return aligned;
             }
-            
-            case FRACTAL: {
-                float scale = 8.0f + sinf(time_offset + noise) * 4.0f;
-                scale *= (1.0f + random_factor * 0.3f);  // Random scale variation
-                return base_seed | ((i*j & i*j) ^ ((int)(i/scale)*(int)(j/scale) & 
-                                  (int)(i/scale)*(int)(j/scale))) ^ ((int)(random_factor * 1000));
-            }
-            
-            case WAVE_INTERFERENCE: {
-                float freq_var = 1.0f + noise;
-                float wave1 = sinf(i*0.05f*freq_var + j*0.05f*freq_var + time_offset + random_factor) * 100;
-                float wave2 = sinf(i*0.08f*freq_var - j*0.03f*freq_var - time_offset*1.5f + random_factor) * 100;
-                float wave3 = sinf(sqrtf(powf(i-Width/2, 2) + powf(j-Height/2, 2)) * 0.1f*freq_var + time_offset*0.5f) * 100;
-                return base_seed | ((int)(wave1 + wave2 + wave3)) ^ ((int)(random_factor * 1000));
+            *pages = POOL_PAGES_NORMAL;
+            return aligned;
+        }
+    }
+#elif defined(__APPLE__) && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+    if (huge_page_mode != HUGE_PAGES_OFF) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+        if (ptr != MAP_FAILED) {
+            *pages = POOL_PAGES_HUGE;
+            return ptr;
+        }
+    }
+#endif
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    *pages = POOL_PAGES_NORMAL;
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// Return a block's memory to the system
+void pool_unmap(PoolBlock* block) {
+    if (block->pages == POOL_PAGES_HEAP) {
+        free(block->ptr);
+    } else {
+        munmap(block->ptr, block->size);
+    }
+    pool_stats.bytes -= block->size;
+    if (block->pages == POOL_PAGES_HUGE) pool_stats.huge_bytes -= block->size;
+}
+
+// Get a 64-byte aligned buffer of at least bytes, reusing the smallest free block of the
+// calling thread's node that fits. Mapped blocks are zero and untouched, so the first write
+// decides their NUMA node; reused blocks keep their old contents.
+void* pool_alloc(size_t bytes) {
+    int node = pool_thread_node;
+    pthread_mutex_lock(&pool_mutex);
+    
+    PoolBlock* best = NULL;
+    for (int b = 0; b < pool_block_count; b++) {
+        PoolBlock* block = &pool_blocks[b];
+        if (!block->in_use && block->node == node && block->size >= bytes &&
+            (!best || block->size < best->size)) {
+            best = block;
+        }
+    }
+    if (best) {
+        best->in_use = true;
+        pool_stats.reuses++;
+        pthread_mutex_unlock(&pool_mutex);
+        return best->ptr;
+    }
+    
+    // Make room in the table by releasing the largest free block
+    if (pool_block_count == POOL_MAX_BLOCKS) {
+        PoolBlock* victim = NULL;
+        for (int b = 0; b < pool_block_count; b++) {
+            if (!pool_blocks[b].in_use && (!victim || pool_blocks[b].size > victim->size)) {
+                victim = &pool_blocks[b];
             }
-            
-            case WAVE2: {
-                float wave_x = sinf(j * 0.1f + time_offset * 2.0f) * 10;
-                float wave_y = cosf(i * 0.1f + time_offset * 2.0f) * 10;
-                int x_new = i + (int)wave_x;
-                int y_new = j + (int)wave_y;
-                return base_seed | (x_new * y_new);
+        }
+        if (!victim) {
+            pthread_mutex_unlock(&pool_mutex);
+            fprintf(stderr, "Frame buffer pool exhausted (%d buffers in use)\n", POOL_MAX_BLOCKS);
+            exit(1);
+        }
+        pool_unmap(victim);
+        *victim = pool_blocks[--pool_block_count];
+    }
+    
+    PoolBlock block = {NULL, bytes, POOL_PAGES_HEAP, true, node};
+    if (bytes >= POOL_HUGE_PAGE_SIZE) {
+        // A whole number of huge pages, so no huge page is shared with another block
+        block.size = (bytes + POOL_HUGE_PAGE_SIZE - 1) & ~(POOL_HUGE_PAGE_SIZE - 1);
+        block.ptr = pool_map(block.size, &block.pages);
+        if (block.pages != POOL_PAGES_HUGE && huge_page_mode != HUGE_PAGES_OFF) {
+            pool_stats.huge_fallbacks++;
+        }
+#ifdef __linux__
+    } else if (node >= 0 && numa_node_count > 1) {
+        // Small blocks of pinned workers get pages of their own, kept out of transparent huge
+        // pages; on the heap they could share a page, or a 2 MB huge page, with another
+        // node's buffers and all land wherever that was touched first
+        block.size = (bytes + 4095) & ~(size_t)4095;
+        void* ptr = mmap(NULL, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr != MAP_FAILED) {
+            madvise(ptr, block.size, MADV_NOHUGEPAGE);
+            block.ptr = ptr;
+            block.pages = POOL_PAGES_NORMAL;
+        }
+#endif
+    } else {
+        block.size = (bytes + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+        if (posix_memalign(&block.ptr, POOL_ALIGN, block.size) == 0) {
+            memset(block.ptr, 0, block.size);
+        } else {
+            block.ptr = NULL;
+        }
+    }
+    if (!block.ptr) {
+        pthread_mutex_unlock(&pool_mutex);
+        fprintf(stderr, "Could not allocate a %zu byte frame buffer\n", bytes);
+        exit(1);
+    }
+    
+    pool_blocks[pool_block_count++] = block;
+    pool_stats.allocations++;
+    pool_stats.bytes += block.size;
+    if (block.pages == POOL_PAGES_HUGE) pool_stats.huge_bytes += block.size;
+    pthread_mutex_unlock(&pool_mutex);
+    return block.ptr;
+}
+
+// Put a pool buffer on the free list; NULL is ignored
+void pool_free(void* ptr) {
+    if (!ptr) return;
+    pthread_mutex_lock(&pool_mutex);
+    for (int b = 0; b < pool_block_count; b++) {
+        if (pool_blocks[b].ptr == ptr) {
+            pool_blocks[b].in_use = false;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+// Release every free block back to the system
+void pool_trim() {
+    pthread_mutex_lock(&pool_mutex);
+    for (int b = 0; b < pool_block_count; ) {
+        if (pool_blocks[b].in_use) {
+            b++;
+            continue;
+        }
+        pool_unmap(&pool_blocks[b]);
+        pool_blocks[b] = pool_blocks[--pool_block_count];
+    }
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+// Kilobytes of this process's anonymous memory the kernel backs with huge pages, -1 if unknown
+long anon_huge_pages_kb() {
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char line[128];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+#else
+    return -1;
+#endif
+}
+
+void print_pool_stats() {
+    printf("\nFrame buffer pool: %ld allocations, %ld reuses, %.1f MB held (%.1f MB huge-page backed, "
+           "%ld fallbacks to normal pages), row pitch %d pixels\n",
+           pool_stats.allocations, pool_stats.reuses, pool_stats.bytes / 1048576.0,
+           pool_stats.huge_bytes / 1048576.0, pool_stats.huge_fallbacks, frame_pitch);
+    long huge_kb = anon_huge_pages_kb();
+    if (huge_kb >= 0) {
+        printf("Kernel AnonHugePages for this process: %ld kB\n", huge_kb);
+    }
+}
+
+void print_field_cache_stats() {
+    long frames = field_cache_stats.hits + field_cache_stats.misses;
+    if (frames == 0) return;
+    printf("Pattern field cache: %ld hits, %ld misses (%.1f%% of %ld frames coloured from a cached field)\n",
+           field_cache_stats.hits, field_cache_stats.misses, 100.0 * field_cache_stats.hits / frames, frames);
+}
+
+// Pixels per row of a pool frame buffer of the given width
+int padded_pitch(int width) {
+    return (width + 63) & ~63;
+}
+
+// Bytes in a full frame, including row padding
+size_t frame_buffer_bytes() {
+    return (size_t)frame_pitch * Height * 3;
+}
+
+// Free the per-thread band buffers so the next frame reallocates them on each worker's node
+void free_thread_buffers() {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (thread_texture_buffers[i]) {
+            pool_free(thread_texture_buffers[i]);
+            thread_texture_buffers[i] = NULL;
+        }
+        thread_texture_sizes[i] = 0;
+        
+        if (thread_seed_buffers[i]) {
+            pool_free(thread_seed_buffers[i]);
+            thread_seed_buffers[i] = NULL;
+        }
+        thread_seed_sizes[i] = 0;
+    }
+}
+
+// Return the frame and band buffers to the pool
+void release_frame_buffers() {
+    pool_free(texture_data);
+    texture_data = NULL;
+    pool_free(texture_back);
+    texture_back = NULL;
+    free_thread_buffers();
+}
+
+// Allocate the shared frame buffer. Fresh pool blocks are untouched, so each band is
+// first-touched by the worker that writes it; band buffers are allocated by the workers.
+void init_frame_buffers(int width, int height) {
+    frame_pitch = padded_pitch(width);
+    texture_data = (uint8_t*)pool_alloc((size_t)frame_pitch * height * 3);  // RGB format
+    free_thread_buffers();
+}
+
+// OpenGL initialization and rendering functions
+void initGL(int width, int height, int argc, char** argv) {
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
+    glutInitWindowSize(width, height);
+    glutCreateWindow("Artmaker");
+    
+    // Set up orthographic projection
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, width, height, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    
+    // Enable texturing
+    glEnable(GL_TEXTURE_2D);
+    
+    // Create and initialize texture
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    // Allocate texture storage; the first frame fills it
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    
+    // Frame rows are padded to frame_pitch pixels; byte alignment covers any width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame_pitch);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    // Pixel buffer objects for streaming frames into the texture
+    glGenBuffers(2, pbo_ids);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_buffer_bytes(), NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void clearScreen() {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void addQuad(Vertex* vertices, int* vertex_count, 
+             float x, float y, float width, float height,
+             float r, float g, float b, float a) {
+    // Add four vertices for the quad
+    vertices[*vertex_count].x = x;
+    vertices[*vertex_count].y = y;
+    vertices[*vertex_count].r = r;
+    vertices[*vertex_count].g = g;
+    vertices[*vertex_count].b = b;
+    vertices[*vertex_count].a = a;
+    (*vertex_count)++;
+
+    vertices[*vertex_count].x = x + width;
+    vertices[*vertex_count].y = y;
+    vertices[*vertex_count].r = r;
+    vertices[*vertex_count].g = g;
+    vertices[*vertex_count].b = b;
+    vertices[*vertex_count].a = a;
+    (*vertex_count)++;
+
+    vertices[*vertex_count].x = x + width;
+    vertices[*vertex_count].y = y + height;
+    vertices[*vertex_count].r = r;
+    vertices[*vertex_count].g = g;
+    vertices[*vertex_count].b = b;
+    vertices[*vertex_count].a = a;
+    (*vertex_count)++;
+
+    vertices[*vertex_count].x = x;
+    vertices[*vertex_count].y = y + height;
+    vertices[*vertex_count].r = r;
+    vertices[*vertex_count].g = g;
+    vertices[*vertex_count].b = b;
+    vertices[*vertex_count].a = a;
+    (*vertex_count)++;
+}
+
+// Cephes sine and cosine polynomials, valid on [-pi/4, pi/4]
+static inline float fast_sin_poly(float r) {
+    float r2 = r * r;
+    return r + r * r2 * (-0.16666654611f + r2 * (0.0083321608736f + r2 * -0.00019515295891f));
+}
+
+static inline float fast_cos_poly(float r) {
+    float r2 = r * r;
+    return 1.0f - 0.5f * r2 + r2 * r2 * (0.041666645683f + r2 * (-0.0013887316255f + r2 * 0.000024433157110f));
+}
+
+// Sine of x plus quadrants quarter turns: reduce to [-pi/4, pi/4] with a three-part pi/2
+// (Cody-Waite), then pick the sine or cosine polynomial and sign by quadrant. Measured max
+// error 9.3e-8 for |x| up to 1e4.
+static inline float fast_sin_quadrant(float x, int quadrants) {
+    float q = fminf(fmaxf(rintf(x * 0.636619772368f), -16777216.0f), 16777216.0f);
+    float r = ((x - q * 1.5703125f) - q * 4.837512969970703125e-4f) - q * 7.54978995489188216e-8f;
+    int n = (int)q + quadrants;
+    float v = (n & 1) ? fast_cos_poly(r) : fast_sin_poly(r);
+    return (n & 2) ? -v : v;
+}
+
+static inline float fast_sinf(float x) {
+    return fast_sin_quadrant(x, 0);
+}
+
+static inline float fast_cosf(float x) {
+    return fast_sin_quadrant(x, 1);
+}
+
+// Arctangent on [0, 1] from Abramowitz and Stegun 4.4.49 with octant reduction (measured
+// max error 1.2e-5 rad)
+static inline float fast_atan2f(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float max_v = fmaxf(ax, ay);
+    if (max_v == 0.0f) return 0.0f;
+    
+    float a = fminf(ax, ay) / max_v;
+    float s = a * a;
+    float r = ((((0.0208351f * s - 0.0851330f) * s + 0.1801410f) * s - 0.3302995f) * s + 0.9998660f) * a;
+    if (ay > ax) r = 1.57079632679f - r;
+    if (x < 0.0f) r = 3.14159265359f - r;
+    return y < 0.0f ? -r : r;
+}
+
+// Precision-tier dispatch; exact and balanced use libm
+static inline float p_sinf(float x) {
+    return precision_mode == PRECISION_FAST ? fast_sinf(x) : sinf(x);
+}
+
+static inline float p_cosf(float x) {
+    return precision_mode == PRECISION_FAST ? fast_cosf(x) : cosf(x);
+}
+
+static inline float p_atan2f(float y, float x) {
+    return precision_mode == PRECISION_FAST ? fast_atan2f(y, x) : atan2f(y, x);
+}
+
+// Float to int conversion for the bitwise operators; out-of-range and NaN values map to 0
+static inline int expr_int(float v) {
+    return (v > -2147483648.0f && v < 2147483648.0f) ? (int)v : 0;
+}
+
+// Spelling and arity of each operator, indexed by op - EOP_FIRST_OP
+#define EXPR_INFO(name, fn, arity, exact, fast) {fn, arity},
+static const struct {
+    const char* fn;
+    int arity;
+} expr_op_info[] = {
+    EXPR_OPS(EXPR_INFO)
+};
+#undef EXPR_INFO
+
+static const struct {
+    const char* name;
+    int op;
+} expr_variables[] = {
+    {"i", EOP_I}, {"j", EOP_J}, {"t", EOP_T}, {"cx", EOP_CX}, {"cy", EOP_CY}, {"w", EOP_W}, {"h", EOP_H}
+};
+
+// The built-in patterns (classic random mode, float tiers) in expression form, for
+// --pattern-expr @name
+#define EXPR_CELL "(50*(1+0.5*sin(t)))"
+#define EXPR_FREQ1 "(0.03*(1+0.5*sin(t)))"
+#define EXPR_FREQ2 "(0.02*(1+0.5*cos(t)))"
+static const struct {
+    const char* name;
+    const char* source;
+} expr_builtins[] = {
+    {"original", "i*j & int(i*cos(t)*j)"},
+    {"polar", "int((sin(hypot(i-cx, j-cy) / (sqrt(w*w + h*h)*0.5) * 10 + t)*0.5 + 0.5) * "
+              "(sin(atan2(j-cy, i-cx)*4 + t)*0.5 + 0.5) * 1000)"},
+    {"trig", "int(sin(i*0.05 + t)*100) * int(cos(j*0.05 - t)*100)"},
+    {"fractal", "i*j ^ (int(i/(8 + sin(t)*4)) * int(j/(8 + sin(t)*4)))"},
+    {"wave", "int(sin(i*0.05 + j*0.05 + t)*100 + sin(i*0.08 - j*0.03 - t*1.5)*100 + "
+             "sin(hypot(i-cx, j-cy)*0.1 + t*0.5)*100)"},
+    {"wave2", "(i + int(sin(j*0.1 + t*2)*10)) * (j + int(cos(i*0.1 + t*2)*10))"},
+    {"vortex", "int(sin(atan2(j-cy, i-cx) + hypot(i-cx, j-cy)*0.02 + t) * cos(hypot(i-cx, j-cy)*0.05 + t) * 1000)"
+               " ^ int(hypot(i-cx, j-cy))"},
+    {"kaleidoscope", "int(sin(fmod(atan2(j-cy, i-cx) + t, 0.785398163)*8 + hypot(i-cx, j-cy)*0.1) * "
+                     "cos(hypot(i-cx, j-cy)*0.05 - t*2) * 1000) * int(hypot(i-cx, j-cy)*0.1)"},
+    {"psychedelic", "int(sin(i*" EXPR_FREQ1 " + t) * cos(j*" EXPR_FREQ2 ") * 1000) ^ "
+                    "int(cos(i*" EXPR_FREQ2 " - t) * sin(j*" EXPR_FREQ1 ") * 1000) ^ "
+                    "int(sin(hypot(i-cx, j-cy)*0.1) * 1000)"},
+    {"cellular", "(int(i/" EXPR_CELL ")*17 + int(j/" EXPR_CELL ")*31) ^ "
+                 "int(hypot(i - (int(i/" EXPR_CELL ") + 0.5)*" EXPR_CELL ", "
+                 "j - (int(j/" EXPR_CELL ") + 0.5)*" EXPR_CELL ") * sin(t*2))"}
+};
+
+// Apply one operator to scalars
+static float expr_scalar(int op, bool fast, float x, float y) {
+    switch (op) {
+#define EXPR_CASE(name, fn, arity, exact, fast_form) case EOP_##name: return fast ? (fast_form) : (exact);
+        EXPR_OPS(EXPR_CASE)
+#undef EXPR_CASE
+        default: return 0.0f;
+    }
+}
+
+// Apply one operator to n lanes; d never aliases a or b, so each loop vectorizes
+static void expr_vector(int op, bool fast, float* restrict d, const float* restrict a,
+                        const float* restrict b, int n) {
+    switch (op) {
+#define EXPR_CASE(name, fn, arity, exact, fast_form) \
+        case EOP_##name: \
+            if (fast) { for (int k = 0; k < n; k++) { float x = a[k], y = b[k]; (void)y; d[k] = (fast_form); } } \
+            else { for (int k = 0; k < n; k++) { float x = a[k], y = b[k]; (void)y; d[k] = (exact); } } \
+            break;
+        EXPR_OPS(EXPR_CASE)
+#undef EXPR_CASE
+        default: break;
+    }
+}
+
+typedef struct {
+    const char* source;
+    const char* p;
+    ExprNode nodes[EXPR_MAX_NODES];
+    int count;
+    const char* error;
+    const char* error_at;
+} ExprParser;
+
+static int expr_fail(ExprParser* ps, const char* message) {
+    if (!ps->error) {
+        ps->error = message;
+        ps->error_at = ps->p;
+    }
+    return -1;
+}
+
+// Add a node, folding operators whose operands are all constants
+static int expr_node(ExprParser* ps, int op, int a, int b, float value) {
+    if (a < 0 && op >= EOP_FIRST_OP) return -1;
+    if (op >= EOP_FIRST_OP && expr_op_info[op - EOP_FIRST_OP].arity == 2 && b < 0) return -1;
+    if (op >= EOP_FIRST_OP && ps->nodes[a].op == EOP_CONST && (b < 0 || ps->nodes[b].op == EOP_CONST)) {
+        value = expr_scalar(op, false, ps->nodes[a].value, b < 0 ? 0.0f : ps->nodes[b].value);
+        op = EOP_CONST;
+        a = b = -1;
+    }
+    if (ps->count == EXPR_MAX_NODES) return expr_fail(ps, "expression too long");
+    ps->nodes[ps->count] = (ExprNode){op, a, b, value};
+    return ps->count++;
+}
+
+static void expr_skip_space(ExprParser* ps) {
+    while (isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+// Consume tok if it is next
+static bool expr_accept(ExprParser* ps, const char* tok) {
+    expr_skip_space(ps);
+    size_t len = strlen(tok);
+    if (strncmp(ps->p, tok, len) != 0) return false;
+    ps->p += len;
+    return true;
+}
+
+static int expr_parse_or(ExprParser* ps);
+
+static int expr_parse_primary(ExprParser* ps) {
+    expr_skip_space(ps);
+    const char* start = ps->p;
+    
+    if (isdigit((unsigned char)*ps->p) || *ps->p == '.') {
+        char* end;
+        float value = strtof(ps->p, &end);
+        if (end == ps->p) return expr_fail(ps, "bad number");
+        ps->p = end;
+        return expr_node(ps, EOP_CONST, -1, -1, value);
+    }
+    
+    if (isalpha((unsigned char)*ps->p) || *ps->p == '_') {
+        while (isalnum((unsigned char)*ps->p) || *ps->p == '_') ps->p++;
+        size_t len = (size_t)(ps->p - start);
+        
+        for (size_t v = 0; v < sizeof(expr_variables) / sizeof(expr_variables[0]); v++) {
+            if (strlen(expr_variables[v].name) == len && strncmp(start, expr_variables[v].name, len) == 0) {
+                return expr_node(ps, expr_variables[v].op, -1, -1, 0.0f);
             }
+        }
+        if (len == 2 && strncmp(start, "pi", 2) == 0) {
+            return expr_node(ps, EOP_CONST, -1, -1, (float)M_PI);
+        }
+        for (int op = EOP_FIRST_OP; op < EOP_COUNT; op++) {
+            const char* fn = expr_op_info[op - EOP_FIRST_OP].fn;
+            if (!fn || strlen(fn) != len || strncmp(start, fn, len) != 0) continue;
             
-            case VORTEX: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float angle = atan2f(dy, dx);
-                float distance = sqrtf(dx*dx + dy*dy);
-                float spiral = angle + distance * 0.02f + time_offset + random_factor;
-                float vortex = sinf(spiral) * cosf(distance * 0.05f + time_offset + random_factor);
-                return base_seed | ((int)(vortex * 1000) ^ (int)(distance)) ^ ((int)(random_factor * 1000));
+            if (!expr_accept(ps, "(")) return expr_fail(ps, "expected '(' after function name");
+            int a = expr_parse_or(ps);
+            int b = -1;
+            if (expr_op_info[op - EOP_FIRST_OP].arity == 2) {
+                if (!expr_accept(ps, ",")) return expr_fail(ps, "expected ','");
+                b = expr_parse_or(ps);
             }
+            if (!expr_accept(ps, ")")) return expr_fail(ps, "expected ')'");
+            return expr_node(ps, op, a, b, 0.0f);
+        }
+        ps->p = start;
+        return expr_fail(ps, "unknown name");
+    }
+    
+    if (expr_accept(ps, "(")) {
+        int node = expr_parse_or(ps);
+        if (!expr_accept(ps, ")")) return expr_fail(ps, "expected ')'");
+        return node;
+    }
+    return expr_fail(ps, "expected a number, variable or '('");
+}
+
+static int expr_parse_unary(ExprParser* ps) {
+    if (expr_accept(ps, "-")) return expr_node(ps, EOP_NEG, expr_parse_unary(ps), -1, 0.0f);
+    if (expr_accept(ps, "~")) return expr_node(ps, EOP_NOT, expr_parse_unary(ps), -1, 0.0f);
+    if (expr_accept(ps, "+")) return expr_parse_unary(ps);
+    return expr_parse_primary(ps);
+}
+
+// Left-associative binary levels, loosest last, with C precedence
+static int expr_parse_mul(ExprParser* ps) {
+    int node = expr_parse_unary(ps);
+    for (;;) {
+        if (expr_accept(ps, "*")) node = expr_node(ps, EOP_MUL, node, expr_parse_unary(ps), 0.0f);
+        else if (expr_accept(ps, "/")) node = expr_node(ps, EOP_DIV, node, expr_parse_unary(ps), 0.0f);
+        else if (expr_accept(ps, "%")) node = expr_node(ps, EOP_MOD, node, expr_parse_unary(ps), 0.0f);
+        else return node;
+    }
+}
+
+static int expr_parse_add(ExprParser* ps) {
+    int node = expr_parse_mul(ps);
+    for (;;) {
+        if (expr_accept(ps, "+")) node = expr_node(ps, EOP_ADD, node, expr_parse_mul(ps), 0.0f);
+        else if (expr_accept(ps, "-")) node = expr_node(ps, EOP_SUB, node, expr_parse_mul(ps), 0.0f);
+        else return node;
+    }
+}
+
+static int expr_parse_shift(ExprParser* ps) {
+    int node = expr_parse_add(ps);
+    for (;;) {
+        if (expr_accept(ps, "<<")) node = expr_node(ps, EOP_SHL, node, expr_parse_add(ps), 0.0f);
+        else if (expr_accept(ps, ">>")) node = expr_node(ps, EOP_SHR, node, expr_parse_add(ps), 0.0f);
+        else return node;
+    }
+}
+
+static int expr_parse_and(ExprParser* ps) {
+    int node = expr_parse_shift(ps);
+    while (expr_accept(ps, "&")) node = expr_node(ps, EOP_AND, node, expr_parse_shift(ps), 0.0f);
+    return node;
+}
+
+static int expr_parse_xor(ExprParser* ps) {
+    int node = expr_parse_and(ps);
+    while (expr_accept(ps, "^")) node = expr_node(ps, EOP_XOR, node, expr_parse_and(ps), 0.0f);
+    return node;
+}
+
+static int expr_parse_or(ExprParser* ps) {
+    int node = expr_parse_xor(ps);
+    while (expr_accept(ps, "|")) node = expr_node(ps, EOP_OR, node, expr_parse_xor(ps), 0.0f);
+    return node;
+}
+
+// Emit the instructions for an AST node in post-order, reusing identical instructions
+static int expr_emit(ExprParser* ps, ExprProgram* prog, int node) {
+    const ExprNode* n = &ps->nodes[node];
+    int a = n->a >= 0 ? expr_emit(ps, prog, n->a) : -1;
+    int b = n->b >= 0 ? expr_emit(ps, prog, n->b) : -1;
+    if (a < -1 || b < -1) return -2;
+    
+    for (int k = 0; k < prog->count; k++) {
+        const ExprInsn* in = &prog->insns[k];
+        if (in->op == n->op && in->a == a && in->b == b && in->value == n->value) return k;
+    }
+    if (prog->count == EXPR_MAX_INSNS) {
+        expr_fail(ps, "expression too complex");
+        return -2;
+    }
+    
+    bool varying = n->op == EOP_I || (a >= 0 && prog->insns[a].varying) || (b >= 0 && prog->insns[b].varying);
+    prog->insns[prog->count] = (ExprInsn){n->op, a, b, n->value, varying, -1};
+    return prog->count++;
+}
+
+// Give registers to varying instructions, freeing each at its last use, and pin one for
+// every uniform value a varying instruction reads
+static bool expr_allocate_registers(ExprProgram* prog) {
+    int last_use[EXPR_MAX_INSNS];
+    bool broadcast[EXPR_MAX_INSNS] = {false};
+    bool in_use[EXPR_MAX_REGS] = {false};
+    
+    for (int k = 0; k < prog->count; k++) last_use[k] = k;
+    for (int k = 0; k < prog->count; k++) {
+        const ExprInsn* in = &prog->insns[k];
+        if (!in->varying) continue;
+        if (in->a >= 0) { last_use[in->a] = k; broadcast[in->a] = !prog->insns[in->a].varying; }
+        if (in->b >= 0) { last_use[in->b] = k; broadcast[in->b] = !prog->insns[in->b].varying; }
+    }
+    last_use[prog->result] = prog->count;
+    
+    // Uniform registers are filled once per row, before any varying code, and kept
+    int pinned = 0;
+    for (int k = 0; k < prog->count; k++) {
+        if (!broadcast[k]) continue;
+        if (pinned == EXPR_MAX_REGS) return false;
+        in_use[pinned] = true;
+        prog->insns[k].reg = pinned++;
+    }
+    
+    for (int k = 0; k < prog->count; k++) {
+        ExprInsn* in = &prog->insns[k];
+        if (!in->varying) continue;
+        
+        int reg = 0;
+        while (reg < EXPR_MAX_REGS && in_use[reg]) reg++;
+        if (reg == EXPR_MAX_REGS) return false;
+        in_use[reg] = true;
+        in->reg = reg;
+        
+        if (in->a >= 0 && prog->insns[in->a].varying && last_use[in->a] == k) in_use[prog->insns[in->a].reg] = false;
+        if (in->b >= 0 && in->b != in->a && prog->insns[in->b].varying && last_use[in->b] == k) {
+            in_use[prog->insns[in->b].reg] = false;
+        }
+    }
+    return true;
+}
+
+// Compile source (or @name for a built-in pattern) into prog; prints the error and returns
+// false if it does not parse
+bool compile_pattern_expr(const char* source, ExprProgram* prog) {
+    if (source[0] == '@') {
+        const char* builtin = NULL;
+        for (size_t k = 0; k < sizeof(expr_builtins) / sizeof(expr_builtins[0]); k++) {
+            if (strcmp(source + 1, expr_builtins[k].name) == 0) builtin = expr_builtins[k].source;
+        }
+        if (!builtin) {
+            fprintf(stderr, "Unknown built-in pattern expression '%s'\n", source);
+            return false;
+        }
+        source = builtin;
+    }
+    
+    ExprParser* ps = (ExprParser*)calloc(1, sizeof(ExprParser));
+    ps->source = ps->p = source;
+    int root = expr_parse_or(ps);
+    expr_skip_space(ps);
+    if (root >= 0 && *ps->p) expr_fail(ps, "unexpected character");
+    
+    prog->count = 0;
+    if (!ps->error) {
+        prog->result = expr_emit(ps, prog, root);
+        if (!ps->error && !expr_allocate_registers(prog)) {
+            ps->p = source + strlen(source);
+            expr_fail(ps, "expression needs too many registers");
+        }
+    }
+    
+    bool ok = !ps->error;
+    if (!ok) {
+        fprintf(stderr, "Pattern expression error: %s\n  %s\n  %*s^\n", ps->error, source,
+                (int)(ps->error_at - source), "");
+    }
+    free(ps);
+    if (ok && prog == &pattern_program) {
+        pattern_program_version++;  // Fields cached for the previous program are stale
+    }
+    return ok;
+}
+
+// Evaluate the program for count pixels of row j, starting at i0 and i_step apart
+void expr_eval_row(const ExprProgram* prog, int i0, int i_step, int count, int j, float time_offset,
+                   unsigned long base_seed, unsigned long* out) {
+    float uniform[EXPR_MAX_INSNS];
+    float regs[EXPR_MAX_REGS][EXPR_CHUNK];
+    bool fast = precision_mode == PRECISION_FAST;
+    
+    // Row pass: everything that does not depend on i, broadcast where varying code reads it
+    for (int k = 0; k < prog->count; k++) {
+        const ExprInsn* in = &prog->insns[k];
+        if (in->varying) continue;
+        float v;
+        switch (in->op) {
+            case EOP_CONST: v = in->value; break;
+            case EOP_J: v = (float)j; break;
+            case EOP_T: v = time_offset; break;
+            case EOP_CX: v = (float)(Width / 2); break;
+            case EOP_CY: v = (float)(Height / 2); break;
+            case EOP_W: v = (float)Width; break;
+            case EOP_H: v = (float)Height; break;
+            default: v = expr_scalar(in->op, fast, uniform[in->a], in->b >= 0 ? uniform[in->b] : 0.0f); break;
+        }
+        uniform[k] = v;
+        if (in->reg >= 0) {
+            for (int lane = 0; lane < EXPR_CHUNK; lane++) regs[in->reg][lane] = v;
+        }
+    }
+    
+    const ExprInsn* result = &prog->insns[prog->result];
+    if (!result->varying) {
+        unsigned long seed = base_seed | (unsigned long)(long)expr_int(uniform[prog->result]);
+        for (int k = 0; k < count; k++) out[k] = seed;
+        return;
+    }
+    
+    // Pixel pass over chunks of the row
+    for (int start = 0; start < count; start += EXPR_CHUNK) {
+        int n = count - start < EXPR_CHUNK ? count - start : EXPR_CHUNK;
+        for (int k = 0; k < prog->count; k++) {
+            const ExprInsn* in = &prog->insns[k];
+            if (!in->varying) continue;
+            float* d = regs[in->reg];
+            if (in->op == EOP_I) {
+                for (int lane = 0; lane < n; lane++) d[lane] = (float)(i0 + (start + lane) * i_step);
+            } else {
+                const float* a = regs[prog->insns[in->a].reg];
+                const float* b = in->b >= 0 ? regs[prog->insns[in->b].reg] : a;
+                expr_vector(in->op, fast, d, a, b, n);
+            }
+        }
+        const float* r = regs[result->reg];
+        for (int lane = 0; lane < n; lane++) {
+            out[start + lane] = base_seed | (unsigned long)(long)expr_int(r[lane]);
+        }
+    }
+}
+
+// Starting point on the attractor for a seed; the trajectory is deterministic from here
+void lorenz_initial_state(unsigned long seed, double state[3]) {
+    state[0] = 1.0 + (double)(seed & 0xffff) / 65536.0;
+    state[1] = 1.0 + (double)((seed >> 16) & 0xffff) / 65536.0;
+    state[2] = 20.0 + (double)(seed % 1000) / 100.0;
+}
+
+static void lorenz_derivative(const double s[3], double d[3]) {
+    const double sigma = 10.0, rho = 28.0, beta = 8.0 / 3.0;
+    d[0] = sigma * (s[1] - s[0]);
+    d[1] = s[0] * (rho - s[2]) - s[1];
+    d[2] = s[0] * s[1] - beta * s[2];
+}
+
+// Advance a state by one frame of animation
+void lorenz_advance_frame(double state[3]) {
+    for (int step = 0; step < LORENZ_STEPS_PER_FRAME; step++) {
+        double k1[3], k2[3], k3[3], k4[3], tmp[3];
+        lorenz_derivative(state, k1);
+        for (int c = 0; c < 3; c++) tmp[c] = state[c] + 0.5 * LORENZ_DT * k1[c];
+        lorenz_derivative(tmp, k2);
+        for (int c = 0; c < 3; c++) tmp[c] = state[c] + 0.5 * LORENZ_DT * k2[c];
+        lorenz_derivative(tmp, k3);
+        for (int c = 0; c < 3; c++) tmp[c] = state[c] + LORENZ_DT * k3[c];
+        lorenz_derivative(tmp, k4);
+        for (int c = 0; c < 3; c++) {
+            state[c] += LORENZ_DT / 6.0 * (k1[c] + 2.0 * k2[c] + 2.0 * k3[c] + k4[c]);
+        }
+    }
+}
+
+// Map an attractor state to the terms the pattern formulas use: x spans about -20..20 and
+// z about 0..50 on the attractor
+ChaosTerms lorenz_terms_from_state(const double state[3]) {
+    ChaosTerms terms;
+    terms.random_factor = fminf(1.0f, fmaxf(0.0f, (float)((state[0] + 20.0) / 40.0)));
+    terms.noise = fminf(1.0f, fmaxf(-1.0f, (float)((state[2] - 25.0) / 25.0))) * 0.2f;
+    return terms;
+}
+
+// Animation frame a time offset belongs to
+int lorenz_frame_index(float time_offset) {
+    int frame = (int)lrintf(time_offset / VIDEO_TIME_STEP);
+    return frame > 0 ? frame : 0;
+}
+
+// Make sure the table holds the checkpoints of seed up to frame, integrating only the missing
+// ones. Video mode calls this once for the whole range before rendering. If the table cannot
+// grow, lookups past it integrate from the last checkpoint there is.
+void lorenz_prepare(unsigned long seed, int frame) {
+    LorenzTable* table = &lorenz_table;
+    if (table->count == 0 || table->seed != seed) {
+        table->seed = seed;
+        table->count = 0;
+        table->cursor_frame = -1;
+    }
+    int needed = frame / LORENZ_CHECKPOINT_STRIDE + 1;
+    if (needed > LORENZ_MAX_CHECKPOINTS) needed = LORENZ_MAX_CHECKPOINTS;
+    if (needed > table->capacity) {
+        int capacity = table->capacity ? table->capacity : 1024;
+        while (capacity < needed) capacity *= 2;
+        if (capacity > LORENZ_MAX_CHECKPOINTS) capacity = LORENZ_MAX_CHECKPOINTS;
+        double (*grown)[3] = (double (*)[3])realloc(table->checkpoints,
+                                                    capacity * sizeof(table->checkpoints[0]));
+        if (grown) {
+            table->checkpoints = grown;
+            table->capacity = capacity;
+        } else {
+            needed = table->capacity;
+        }
+    }
+    if (table->count == 0 && needed > 0) {
+        lorenz_initial_state(seed, table->checkpoints[0]);
+        table->count = 1;
+    }
+    while (table->count < needed) {
+        double* state = table->checkpoints[table->count];
+        memcpy(state, table->checkpoints[table->count - 1], sizeof(table->checkpoints[0]));
+        for (int step = 0; step < LORENZ_CHECKPOINT_STRIDE; step++) {
+            lorenz_advance_frame(state);
+        }
+        table->count++;
+    }
+}
+
+// Terms for one frame: at most a stride of integration once the checkpoints are there, and
+// one frame when frames are looked up in order. Main thread only; the result is handed to
+// the render threads through ThreadWork.
+ChaosTerms lorenz_terms(unsigned long seed, float time_offset) {
+    ChaosTerms none = {0.0f, 0.0f};
+    if (random_mode != LORENZ_RANDOM) return none;
+    int frame = lorenz_frame_index(time_offset);
+    lorenz_prepare(seed, frame);
+    
+    LorenzTable* table = &lorenz_table;
+    int checkpoint = frame / LORENZ_CHECKPOINT_STRIDE;
+    if (checkpoint > table->count - 1) checkpoint = table->count - 1;
+    int from = checkpoint >= 0 ? checkpoint * LORENZ_CHECKPOINT_STRIDE : 0;
+    if (table->cursor_frame >= from && table->cursor_frame <= frame) {
+        from = table->cursor_frame;
+    } else if (checkpoint >= 0) {
+        memcpy(table->cursor, table->checkpoints[checkpoint], sizeof(table->cursor));
+    } else {
+        lorenz_initial_state(seed, table->cursor);
+    }
+    for (; from < frame; from++) {
+        lorenz_advance_frame(table->cursor);
+    }
+    table->cursor_frame = frame;
+    return lorenz_terms_from_state(table->cursor);
+}
+
+// Same terms without the shared table, for threads judging many seeds at one time
+ChaosTerms lorenz_terms_uncached(unsigned long seed, float time_offset) {
+    ChaosTerms none = {0.0f, 0.0f};
+    if (random_mode != LORENZ_RANDOM) return none;
+    double state[3];
+    lorenz_initial_state(seed, state);
+    for (int frame = lorenz_frame_index(time_offset); frame > 0; frame--) {
+        lorenz_advance_frame(state);
+    }
+    return lorenz_terms_from_state(state);
+}
+
+// Function to calculate pattern seed with time offset
+unsigned long calculate_pattern_seed(int i, int j, PatternType pattern_type, float time_offset, int Width, int Height, unsigned long base_seed,
+                                     const ChaosTerms* chaos) {
+    int centerX = Width / 2;
+    int centerY = Height / 2;
+    
+    if (pattern_type == PATTERN_EXPR) {
+        unsigned long seed;
+        expr_eval_row(&pattern_program, i, 1, 1, j, time_offset, base_seed, &seed);
+        return seed;
+    }
+    
+    if (random_mode == ENHANCED_RANDOM || random_mode == LORENZ_RANDOM) {
+        // Add some global randomness factors; Lorenz mode uses the frame's attractor terms
+        float random_factor, noise;
+        if (random_mode == LORENZ_RANDOM) {
+            random_factor = chaos->random_factor;
+            noise = chaos->noise;
+        } else {
+            random_factor = (float)rand() / RAND_MAX;
+            noise = (random_factor * 2.0f - 1.0f) * 0.2f; // Random noise between -0.2 and 0.2
+        }
+        
+        switch(pattern_type) {
+            case ORIGINAL:
+                if (precision_mode == PRECISION_EXACT) {
+                    return base_seed | ((i*j & (int)(i*cos(time_offset + noise)*j)) ^ ((int)(random_factor * 1000)));
+                }
+                return base_seed | ((i*j & (int)(i*p_cosf(time_offset + noise)*j)) ^ ((int)(random_factor * 1000)));
+                
+            case POLAR: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float distance = sqrtf(dx*dx + dy*dy) / (sqrtf(Width*Width + Height*Height) * 0.5f);
+                float angle = p_atan2f(dy, dx);
+                float pattern = (p_sinf(distance * 10.0f + time_offset) * 0.5f + 0.5f) * 
+                              (p_sinf(angle * 4.0f + time_offset + noise) * 0.5f + 0.5f);
+                return base_seed | ((int)(pattern * 1000) ^ ((int)(random_factor * 1000)));
+            }
+            
+            case TRIGONOMETRIC: {
+                float freq_mod = 0.05f * (1.0f + noise);
+                return base_seed | ((int)(p_sinf(i*freq_mod + time_offset + random_factor)*100) * 
+                                  (int)(p_cosf(j*freq_mod - time_offset + random_factor)*100));
+            }
+            
+            case FRACTAL: {
+                float scale = 8.0f + p_sinf(time_offset + noise) * 4.0f;
+                scale *= (1.0f + random_factor * 0.3f);  // Random scale variation
+                return base_seed | ((i*j & i*j) ^ ((int)(i/scale)*(int)(j/scale) & 
+                                  (int)(i/scale)*(int)(j/scale))) ^ ((int)(random_factor * 1000));
+            }
+            
+            case WAVE_INTERFERENCE: {
+                float freq_var = 1.0f + noise;
+                float wave1 = p_sinf(i*0.05f*freq_var + j*0.05f*freq_var + time_offset + random_factor) * 100;
+                float wave2 = p_sinf(i*0.08f*freq_var - j*0.03f*freq_var - time_offset*1.5f + random_factor) * 100;
+                float wave3;
+                if (precision_mode == PRECISION_EXACT) {
+                    wave3 = sinf(sqrtf(powf(i-Width/2, 2) + powf(j-Height/2, 2)) * 0.1f*freq_var + time_offset*0.5f) * 100;
+                } else {
+                    float dx = (float)(i - Width/2);
+                    float dy = (float)(j - Height/2);
+                    wave3 = p_sinf(sqrtf(dx*dx + dy*dy) * 0.1f*freq_var + time_offset*0.5f) * 100;
+                }
+                return base_seed | ((int)(wave1 + wave2 + wave3)) ^ ((int)(random_factor * 1000));
+            }
+            
+            case WAVE2: {
+                float wave_x = p_sinf(j * 0.1f + time_offset * 2.0f) * 10;
+                float wave_y = p_cosf(i * 0.1f + time_offset * 2.0f) * 10;
+                int x_new = i + (int)wave_x;
+                int y_new = j + (int)wave_y;
+                return base_seed | (x_new * y_new);
+            }
+            
+            case VORTEX: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float angle = p_atan2f(dy, dx);
+                float distance = sqrtf(dx*dx + dy*dy);
+                float spiral = angle + distance * 0.02f + time_offset + random_factor;
+                float vortex = p_sinf(spiral) * p_cosf(distance * 0.05f + time_offset + random_factor);
+                return base_seed | ((int)(vortex * 1000) ^ (int)(distance)) ^ ((int)(random_factor * 1000));
+            }
+
+            case KALEIDOSCOPE: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float angle = fmodf(p_atan2f(dy, dx) + time_offset + random_factor, M_PI/4);
+                float distance = sqrtf(dx*dx + dy*dy);
+                float kaleid = p_sinf(angle * 8 + distance * 0.1f + random_factor) * p_cosf(distance * 0.05f - time_offset * 2 + random_factor);
+                return base_seed | ((int)(kaleid * 1000) * (int)(distance * 0.1f)) ^ ((int)(random_factor * 1000));
+            }
+
+            case CELLULAR: {
+                float cell_size = 50.0f * (1.0f + 0.5f * p_sinf(time_offset + noise));
+                int cell_x = (int)(i / cell_size);
+                int cell_y = (int)(j / cell_size);
+                float dx = i - (cell_x + 0.5f) * cell_size;
+                float dy = j - (cell_y + 0.5f) * cell_size;
+                float dist = sqrtf(dx*dx + dy*dy);
+                return base_seed | ((cell_x * 17 + cell_y * 31) ^ (int)(dist * p_sinf(time_offset * 2 + random_factor)));
+            }
+
+            case PSYCHEDELIC: {
+                float freq1 = 0.03f * (1.0f + 0.5f * p_sinf(time_offset + noise));
+                float freq2 = 0.02f * (1.0f + 0.5f * p_cosf(time_offset + noise));
+                float wave1 = p_sinf(i * freq1 + time_offset + random_factor) * p_cosf(j * freq2);
+                float wave2 = p_cosf(i * freq2 - time_offset - random_factor) * p_sinf(j * freq1);
+                float wave3 = p_sinf(sqrtf((i-centerX)*(i-centerX) + (j-centerY)*(j-centerY)) * 0.1f + random_factor);
+                return base_seed | ((int)(wave1 * 1000) ^ (int)(wave2 * 1000) ^ (int)(wave3 * 1000));
+            }
+
+            default:
+                return base_seed;
+        }
+    } else {
+        // Classic random mode
+        switch(pattern_type) {
+            case ORIGINAL:
+                if (precision_mode == PRECISION_EXACT) {
+                    return base_seed | (i*j & (int)(i*cos(time_offset)*j));
+                }
+                return base_seed | (i*j & (int)(i*p_cosf(time_offset)*j));
+                
+            case POLAR: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float distance = sqrtf(dx*dx + dy*dy) / (sqrtf(Width*Width + Height*Height) * 0.5f);
+                float angle = p_atan2f(dy, dx);
+                float pattern = (p_sinf(distance * 10.0f + time_offset) * 0.5f + 0.5f) * 
+                              (p_sinf(angle * 4.0f + time_offset) * 0.5f + 0.5f);
+                return base_seed | ((int)(pattern * 1000));
+            }
+                
+            case TRIGONOMETRIC:
+                if (precision_mode == PRECISION_EXACT) {
+                    return base_seed | ((int)(sinf(i*0.05 + time_offset)*100) * 
+                                      (int)(cosf(j*0.05 - time_offset)*100));
+                }
+                return base_seed | ((int)(p_sinf(i*0.05f + time_offset)*100) * 
+                                  (int)(p_cosf(j*0.05f - time_offset)*100));
+                
+            case FRACTAL: {
+                float scale = 8.0f + p_sinf(time_offset) * 4.0f;
+                return base_seed | ((i*j & i*j) ^ ((int)(i/scale)*(int)(j/scale) & 
+                                  (int)(i/scale)*(int)(j/scale)));
+            }
+                
+            case WAVE_INTERFERENCE: {
+                if (precision_mode == PRECISION_EXACT) {
+                    float wave1 = sinf(i*0.05 + j*0.05 + time_offset) * 100;
+                    float wave2 = sinf(i*0.08 - j*0.03 - time_offset*1.5) * 100;
+                    float wave3 = sinf(sqrtf(powf(i-Width/2, 2) + powf(j-Height/2, 2)) * 0.1 + time_offset*0.5) * 100;
+                    return base_seed | ((int)(wave1 + wave2 + wave3));
+                }
+                float dx = (float)(i - Width/2);
+                float dy = (float)(j - Height/2);
+                float wave1 = p_sinf(i*0.05f + j*0.05f + time_offset) * 100;
+                float wave2 = p_sinf(i*0.08f - j*0.03f - time_offset*1.5f) * 100;
+                float wave3 = p_sinf(sqrtf(dx*dx + dy*dy) * 0.1f + time_offset*0.5f) * 100;
+                return base_seed | ((int)(wave1 + wave2 + wave3));
+            }
+                
+            case WAVE2: {
+                float wave_x = p_sinf(j * 0.1f + time_offset * 2.0f) * 10;
+                float wave_y = p_cosf(i * 0.1f + time_offset * 2.0f) * 10;
+                int x_new = i + (int)wave_x;
+                int y_new = j + (int)wave_y;
+                return base_seed | (x_new * y_new);
+            }
+                
+            case VORTEX: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float angle = p_atan2f(dy, dx);
+                float distance = sqrtf(dx*dx + dy*dy);
+                float spiral = angle + distance * 0.02f + time_offset;
+                float vortex = p_sinf(spiral) * p_cosf(distance * 0.05f + time_offset);
+                return base_seed | ((int)(vortex * 1000) ^ (int)(distance));
+            }
+
+            case KALEIDOSCOPE: {
+                float dx = i - centerX;
+                float dy = j - centerY;
+                float angle = fmodf(p_atan2f(dy, dx) + time_offset, M_PI/4);
+                float distance = sqrtf(dx*dx + dy*dy);
+                float kaleid = p_sinf(angle * 8 + distance * 0.1f) * p_cosf(distance * 0.05f - time_offset * 2);
+                return base_seed | ((int)(kaleid * 1000) * (int)(distance * 0.1f));
+            }
+
+            case CELLULAR: {
+                float cell_size = 50.0f * (1.0f + 0.5f * p_sinf(time_offset));
+                int cell_x = (int)(i / cell_size);
+                int cell_y = (int)(j / cell_size);
+                float dx = i - (cell_x + 0.5f) * cell_size;
+                float dy = j - (cell_y + 0.5f) * cell_size;
+                float dist = sqrtf(dx*dx + dy*dy);
+                return base_seed | ((cell_x * 17 + cell_y * 31) ^ (int)(dist * p_sinf(time_offset * 2)));
+            }
+
+            case PSYCHEDELIC: {
+                float freq1 = 0.03f * (1.0f + 0.5f * p_sinf(time_offset));
+                float freq2 = 0.02f * (1.0f + 0.5f * p_cosf(time_offset));
+                float wave1 = p_sinf(i * freq1 + time_offset) * p_cosf(j * freq2);
+                float wave2 = p_cosf(i * freq2 - time_offset) * p_sinf(j * freq1);
+                float wave3 = p_sinf(sqrtf((i-centerX)*(i-centerX) + (j-centerY)*(j-centerY)) * 0.1f);
+                return base_seed | ((int)(wave1 * 1000) ^ (int)(wave2 * 1000) ^ (int)(wave3 * 1000));
+            }
+
+            default:
+                return base_seed;
+        }
+    }
+    return base_seed;
+}
+
+// Seeds for count pixels of row j, starting at i0 and i_step apart
+void pattern_row_seeds(PatternType pattern_type, int i0, int i_step, int count, int j, float time_offset,
+                       unsigned long base_seed, const ChaosTerms* chaos, unsigned long* out) {
+    if (pattern_type == PATTERN_EXPR) {
+        expr_eval_row(&pattern_program, i0, i_step, count, j, time_offset, base_seed, out);
+        return;
+    }
+    for (int k = 0; k < count; k++) {
+        out[k] = calculate_pattern_seed(i0 + k * i_step, j, pattern_type, time_offset, Width, Height, base_seed, chaos);
+    }
+}
+
+static inline bool color_mode_is_palette(ColorMode mode) {
+    return mode >= COLOR_MODE_RAINBOW && mode <= COLOR_MODE_PALETTE;
+}
+
+static inline float clamp01(float v) {
+    return fmaxf(0.0f, fminf(1.0f, v));
+}
+
+// Fill lut with size entries of a built-in palette. Every palette wraps around smoothly so
+// rotation never shows a seam.
+void generate_builtin_palette(ColorMode mode, uint8_t* lut, unsigned int size) {
+    for (unsigned int k = 0; k < size; k++) {
+        float t = (float)k / size;
+        float u = 1.0f - fabsf(2.0f * t - 1.0f);  // 0 -> 1 -> 0 over the table
+        float r, g, b;
+        if (mode == COLOR_MODE_RAINBOW) {
+            // Rainbow Wave: a full hue circle with three brightness waves riding on it
+            float h = t * 6.0f;
+            float v = 0.8f + 0.2f * sinf(t * 6.0f * (float)M_PI);
+            r = clamp01(fabsf(h - 3.0f) - 1.0f) * v;
+            g = clamp01(2.0f - fabsf(h - 2.0f)) * v;
+            b = clamp01(2.0f - fabsf(h - 4.0f)) * v;
+        } else if (mode == COLOR_MODE_FIRE) {
+            r = clamp01(3.0f * u);
+            g = clamp01(3.0f * u - 1.0f);
+            b = clamp01(3.0f * u - 2.0f);
+        } else { // COLOR_MODE_OCEAN
+            r = 0.6f * u * u;
+            g = 0.15f + 0.75f * u;
+            b = 0.35f + 0.65f * u;
+        }
+        lut[k * 3] = (uint8_t)(r * 255.0f);
+        lut[k * 3 + 1] = (uint8_t)(g * 255.0f);
+        lut[k * 3 + 2] = (uint8_t)(b * 255.0f);
+    }
+}
+
+// Load a palette file: one "r g b" line (0-255) per entry, other lines ignored, so GIMP .gpl
+// files load as they are. The entries are interpolated to 256 entries, or 1024 if there are
+// more than 256.
+bool load_palette(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot open palette '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    static uint8_t entries[PALETTE_MAX_SIZE][3];
+    int count = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int r, g, b;
+        if (line[0] == '#' || sscanf(line, "%d %d %d", &r, &g, &b) != 3) continue;
+        if (count == PALETTE_MAX_SIZE) {
+            fprintf(stderr, "Palette '%s' has more than %d entries\n", path, PALETTE_MAX_SIZE);
+            fclose(f);
+            return false;
+        }
+        entries[count][0] = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+        entries[count][1] = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+        entries[count][2] = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+        count++;
+    }
+    fclose(f);
+    if (count < 2) {
+        fprintf(stderr, "Palette '%s' needs at least 2 'r g b' entries\n", path);
+        return false;
+    }
+    
+    palette_file_size = count > 256 ? PALETTE_MAX_SIZE : 256;
+    for (unsigned int k = 0; k < palette_file_size; k++) {
+        float pos = (float)k * (count - 1) / (palette_file_size - 1);
+        int e = (int)pos;
+        if (e >= count - 1) e = count - 2;
+        float frac = pos - e;
+        for (int c = 0; c < 3; c++) {
+            palette_file_lut[k * 3 + c] = (uint8_t)(entries[e][c] + (entries[e + 1][c] - entries[e][c]) * frac + 0.5f);
+        }
+    }
+    snprintf(palette_path, sizeof(palette_path), "%s", path);
+    palette_lut_mode = COLOR_MODE_COUNT;  // Rebuild if the palette mode is already current
+    return true;
+}
+
+// The loaded palette as "<entries> <hex rgb bytes>", for farm workers that cannot read the
+// coordinator's palette file. out must hold PALETTE_MESSAGE_SIZE bytes.
+#define PALETTE_MESSAGE_SIZE (PALETTE_MAX_SIZE * 6 + 16)
+void palette_to_hex(char* out) {
+    int len = sprintf(out, "%u ", palette_file_size);
+    for (unsigned int k = 0; k < palette_file_size * 3; k++) {
+        len += sprintf(out + len, "%02x", palette_file_lut[k]);
+    }
+}
+
+// Install a palette sent by palette_to_hex
+bool palette_from_hex(const char* text) {
+    unsigned int size;
+    int skip;
+    if (sscanf(text, "%u %n", &size, &skip) != 1 || (size != 256 && size != PALETTE_MAX_SIZE) ||
+        strlen(text + skip) != size * 6) {
+        fprintf(stderr, "Malformed palette from the coordinator\n");
+        return false;
+    }
+    for (unsigned int k = 0; k < size * 3; k++) {
+        unsigned int byte;
+        if (sscanf(text + skip + k * 2, "%2x", &byte) != 1) {
+            fprintf(stderr, "Malformed palette from the coordinator\n");
+            return false;
+        }
+        palette_file_lut[k] = (uint8_t)byte;
+    }
+    palette_file_size = size;
+    snprintf(palette_path, sizeof(palette_path), "(coordinator)");
+    palette_lut_mode = COLOR_MODE_COUNT;
+    return true;
+}
+
+// Build the table for the current colour mode if it changed. Main thread only, between frames.
+void palette_prepare() {
+    if (!color_mode_is_palette(color_mode) || palette_lut_mode == color_mode) return;
+    if (color_mode == COLOR_MODE_PALETTE && palette_file_size == 0) {
+        color_mode = COLOR_MODE_RAINBOW;  // No file loaded; the nearest palette mode
+    }
+    if (color_mode == COLOR_MODE_PALETTE) {
+        palette_size = palette_file_size;
+        memcpy(palette_lut, palette_file_lut, palette_size * 3);
+    } else {
+        palette_size = PALETTE_MAX_SIZE;
+        generate_builtin_palette(color_mode, palette_lut, palette_size);
+    }
+    palette_lut_mode = color_mode;
+}
+
+// Rotation of the palette at the given animation time, in table entries
+static inline unsigned int palette_offset(float time_offset) {
+    return (unsigned int)(time_offset * PALETTE_ROTATION_RATE * palette_size);
+}
+
+// Map a pattern seed to an RGB pixel using the current color mode
+static inline void shade_pixel(unsigned long pattern_seed, float time_offset, uint8_t* out) {
+    if (color_mode_is_palette(color_mode)) {
+        const uint8_t* c = &palette_lut[((pattern_seed + palette_offset(time_offset)) & (palette_size - 1)) * 3];
+        out[0] = c[0];
+        out[1] = c[1];
+        out[2] = c[2];
+        return;
+    }
+    
+    // Per-pixel random value derived from the seed alone, so shading is repeatable and
+    // threads do not contend on the global rand() state
+    unsigned int rand_state = (unsigned int)pattern_seed;
+
+    float r, g, b;
+    float random_factor = (float)rand_r(&rand_state) / RAND_MAX;
+
+    if (color_mode == COLOR_MODE_1) {
+        // Original color mode
+        float random_shift = random_factor * 0.2f - 0.1f;
+        r = ((pattern_seed % 256) / 255.0f + random_shift);
+        g = (((pattern_seed >> 8) % 256) / 255.0f + random_shift);
+        b = (((pattern_seed >> 16) % 256) / 255.0f + random_shift);
+
+        // Add time-based color pulsing with random phase
+        float phase_shift = random_factor * M_PI;
+        r *= (0.7f + 0.3f * p_sinf(time_offset + phase_shift));
+        g *= (0.7f + 0.3f * p_sinf(time_offset + 2.094f + phase_shift));
+        b *= (0.7f + 0.3f * p_sinf(time_offset + 4.189f + phase_shift));
+    } else if (color_mode == COLOR_MODE_2) {
+        // Enhanced color mode
+        float base = (float)(pattern_seed % 1000) / 1000.0f;
+        r = base;
+        g = fmodf(base + 0.33f + 0.1f * p_sinf(time_offset + random_factor), 1.0f);
+        b = fmodf(base + 0.66f + 0.1f * p_cosf(time_offset + random_factor), 1.0f);
+
+        float contrast = 0.3f;
+        r = 0.5f + (r - 0.5f) * (1.0f + contrast);
+        g = 0.5f + (g - 0.5f) * (1.0f + contrast);
+        b = 0.5f + (b - 0.5f) * (1.0f + contrast);
+    } else { // COLOR_MODE_MONO
+        float intensity = (float)(pattern_seed % 1000) / 1000.0f;
+        intensity = intensity * 0.8f + 0.2f * p_sinf(time_offset + random_factor);
+        float contrast = 0.4f;
+        intensity = 0.5f + (intensity - 0.5f) * (1.0f + contrast);
+        r = g = b = intensity;
+    }
+
+    // Clamp colors
+    r = fmaxf(0.0f, fminf(1.0f, r));
+    g = fmaxf(0.0f, fminf(1.0f, g));
+    b = fmaxf(0.0f, fminf(1.0f, b));
+    
+    out[0] = (uint8_t)(r * 255.0f);
+    out[1] = (uint8_t)(g * 255.0f);
+    out[2] = (uint8_t)(b * 255.0f);
+}
+
+// Colour count pixels of band row `row` from column i0, from the band's seeds. Palette modes
+// are one table load per pixel.
+static inline void colour_span(const ThreadWork* work, const unsigned long* seeds, int row, int i0, int count) {
+    size_t p = (size_t)row * frame_pitch + i0;
+    uint8_t* dst = &work->texture_buffer[p * 3];
+    if (color_mode_is_palette(color_mode)) {
+        unsigned int offset = palette_offset(work->colour_time);
+        unsigned int mask = palette_size - 1;
+        for (int k = 0; k < count; k++, p++, dst += 3) {
+            const uint8_t* c = &palette_lut[((seeds[p] + offset) & mask) * 3];
+            dst[0] = c[0];
+            dst[1] = c[1];
+            dst[2] = c[2];
+        }
+    } else {
+        for (int k = 0; k < count; k++, p++, dst += 3) {
+            shade_pixel(seeds[p], work->colour_time, dst);
+        }
+    }
+}
+
+// Even bits of a Morton code, i.e. the x coordinate; pass code >> 1 for y
+static inline unsigned int morton_decode(unsigned int code) {
+    code &= 0x55555555;
+    code = (code | (code >> 1)) & 0x33333333;
+    code = (code | (code >> 2)) & 0x0f0f0f0f;
+    code = (code | (code >> 4)) & 0x00ff00ff;
+    code = (code | (code >> 8)) & 0x0000ffff;
+    return code;
+}
+
+static inline bool work_cancelled(ThreadWork* work) {
+    if (work->cancel && __atomic_load_n(work->cancel, __ATOMIC_RELAXED)) {
+        work->cancelled = true;
+    }
+    return work->cancelled;
+}
+
+// Thread function for parallel processing of art generation
+void* generate_art_thread(void* arg) {
+    ThreadWork* work = (ThreadWork*)arg;
+    int slot = work->slot;
+    size_t row_bytes = (size_t)frame_pitch * 3;
+    int band_rows = work->end_row - work->start_row;
+    size_t band_pixels = (size_t)band_rows * frame_pitch;
+    size_t band_bytes = band_pixels * 3;
+    TRACE_SET_SLOT(slot + 1);
+    pool_thread_node = work->node;
+    
+    // (Re)allocate this thread's band buffers from the worker so they land on the local node
+    if (thread_texture_sizes[slot] < band_bytes) {
+        pool_free(thread_texture_buffers[slot]);
+        thread_texture_buffers[slot] = (uint8_t*)pool_alloc(band_bytes);
+        memset(thread_texture_buffers[slot], 0, band_bytes);
+        thread_texture_sizes[slot] = band_bytes;
+    }
+    if (thread_seed_sizes[slot] < band_pixels * sizeof(unsigned long)) {
+        pool_free(thread_seed_buffers[slot]);
+        thread_seed_buffers[slot] = (unsigned long*)pool_alloc(band_pixels * sizeof(unsigned long));
+        memset(thread_seed_buffers[slot], 0, band_pixels * sizeof(unsigned long));
+        thread_seed_sizes[slot] = band_pixels * sizeof(unsigned long);
+        field_cache_keys[slot].valid = false;
+    }
+    // Without staging, colour straight into this band of the shared frame
+    work->texture_buffer = staged_bands ? thread_texture_buffers[slot]
+                                        : &work->frame[(size_t)work->start_row * row_bytes];
+    unsigned long* seeds = thread_seed_buffers[slot];
+    
+    int counter_fds[NUM_COUNTERS];
+    bool counting = use_counters && counters_open(counter_fds);
+    
+    // Evaluate the seed of every pixel in the band, unless the buffer already holds this band
+    // of the same field, and colour it from the seeds
+    FieldKey key = {true, work->seed, work->pattern_type,
+                    work->pattern_type == PATTERN_EXPR ? pattern_program_version : 0,
+                    random_mode, precision_mode, work->time_offset,
+                    work->start_row, work->end_row, Width, Height};
+    FieldKey* held = &field_cache_keys[slot];
+    work->field_hit = field_key_equal(held, &key);
+    work->cancelled = false;
+    if (!work->field_hit) {
+        held->valid = false;  // Until the band's seeds are complete
+    }
+    if (work->field_hit || traversal_mode == TRAVERSAL_ROWS) {
+        if (!work->field_hit) {
+            TRACE_BEGIN("pattern");
+            for(int j = work->start_row; j < work->end_row && !work_cancelled(work); j++) {
+                pattern_row_seeds(work->pattern_type, 0, 1, Width, j, work->time_offset, work->seed, &work->chaos,
+                                  &seeds[(size_t)(j - work->start_row) * frame_pitch]);
+            }
+            TRACE_END("pattern");
+        }
+        
+        TRACE_BEGIN("colour");
+        for (int row = 0; row < band_rows && !work_cancelled(work); row++) {
+            colour_span(work, seeds, row, 0, Width);
+        }
+        TRACE_END("colour");
+    } else {
+        // Tiles of the band in Z-order; codes that fall outside the band are skipped
+        int tiles_x = (Width + TILE_SIZE - 1) / TILE_SIZE;
+        int tiles_y = (band_rows + TILE_SIZE - 1) / TILE_SIZE;
+        unsigned int side = 1;
+        while (side < (unsigned int)tiles_x || side < (unsigned int)tiles_y) side <<= 1;
+        
+        TRACE_BEGIN("tiles");
+        for (unsigned int code = 0; code < side * side && !work_cancelled(work); code++) {
+            int tx = (int)morton_decode(code), ty = (int)morton_decode(code >> 1);
+            if (tx >= tiles_x || ty >= tiles_y) continue;
+            int i0 = tx * TILE_SIZE, row0 = ty * TILE_SIZE;
+            int count = Width - i0 < TILE_SIZE ? Width - i0 : TILE_SIZE;
+            int row_end = band_rows - row0 < TILE_SIZE ? band_rows : row0 + TILE_SIZE;
+            
+            for (int row = row0; row < row_end; row++) {
+                pattern_row_seeds(work->pattern_type, i0, 1, count, work->start_row + row, work->time_offset,
+                                  work->seed, &work->chaos, &seeds[(size_t)row * frame_pitch + i0]);
+            }
+            for (int row = row0; row < row_end; row++) {
+                colour_span(work, seeds, row, i0, count);
+            }
+        }
+        TRACE_END("tiles");
+    }
+    if (!work->cancelled) {
+        *held = key;
+    }
+    
+    // Copy the finished band into the shared frame; bands are disjoint, so no locking needed
+    if (staged_bands && !work->cancelled) {
+        TRACE_BEGIN("merge");
+        memcpy(&work->frame[(size_t)work->start_row * row_bytes], work->texture_buffer, band_bytes);
+        TRACE_END("merge");
+    }
+    
+    if (counting) {
+        counters_close(counter_fds, &worker_counters[slot]);
+    }
+    
+    work->finish_time = get_current_time();
+    return NULL;
+}
+
+// Stream a finished frame into the texture through the next pixel buffer object. The buffer
+// is orphaned before mapping, so the copy never waits for the GPU to finish with the previous
+// upload, and glTexSubImage2D from the bound PBO returns without blocking on the transfer.
+void upload_frame(const uint8_t* frame) {
+    size_t frame_bytes = frame_buffer_bytes();
+    TRACE_BEGIN("glTexSubImage2D");
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids[pbo_index]);
+    pbo_index ^= 1;
+    
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes, NULL, GL_STREAM_DRAW);
+    void* mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (mapped) {
+        memcpy(mapped, frame, frame_bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, (const void*)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        // Mapping failed; fall back to a plain client-memory upload
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, frame);
+    }
+    TRACE_END("glTexSubImage2D");
+}
+
+// Thread function for one progressive refinement pass. Each sample is shaded once and
+// splatted over its step x step block of texture_data; samples that already landed on the
+// coarser grid of the previous pass keep their block corner and are not evaluated again.
+void* generate_progressive_thread(void* arg) {
+    ThreadWork* work = (ThreadWork*)arg;
+    int step = work->step;
+    bool reuse_coarse = step < PROGRESSIVE_START_STEP;
+    TRACE_SET_SLOT(work->slot + 1);
+    TRACE_BEGIN("progressive_pass");
+    
+    for (int j = work->start_row; j < work->end_row; j += step) {
+        // On rows of the coarser grid, only the samples between its points are new
+        bool coarse_row = reuse_coarse && j % (step * 2) == 0;
+        int i0 = coarse_row ? step : 0;
+        int i_step = coarse_row ? step * 2 : step;
+        int count = i0 < Width ? (Width - 1 - i0) / i_step + 1 : 0;
+        
+        for (int start = 0; start < count; start += EXPR_CHUNK) {
+            unsigned long seeds[EXPR_CHUNK];
+            int n = count - start < EXPR_CHUNK ? count - start : EXPR_CHUNK;
+            pattern_row_seeds(work->pattern_type, i0 + start * i_step, i_step, n, j,
+                              work->time_offset, work->seed, &work->chaos, seeds);
+            
+            for (int k = 0; k < n; k++) {
+                int i = i0 + (start + k) * i_step;
+                uint8_t rgb[3];
+                shade_pixel(seeds[k], work->colour_time, rgb);
+                
+                int block_w = (i + step <= Width) ? step : Width - i;
+                int block_h = (j + step <= Height) ? step : Height - j;
+                for (int y = 0; y < block_h; y++) {
+                    uint8_t* dst = &work->frame[((size_t)(j + y) * frame_pitch + i) * 3];
+                    for (int x = 0; x < block_w; x++) {
+                        dst[x * 3] = rgb[0];
+                        dst[x * 3 + 1] = rgb[1];
+                        dst[x * 3 + 2] = rgb[2];
+                    }
+                }
+            }
+        }
+    }
+    
+    TRACE_END("progressive_pass");
+    return NULL;
+}
+
+// Run the next progressive refinement pass into texture_data and upload it. Passes go
+// 8 -> 4 -> 2 -> 1, so together they evaluate every pixel exactly once.
+void generateArtProgressive(unsigned long seed, PatternType pattern_type, float time_offset) {
+    int step = progressive_step;
+    palette_prepare();
+    float colour_time = time_offset;
+    if (field_frozen) time_offset = frozen_field_time;
+    ChaosTerms chaos = lorenz_terms(seed, time_offset);
+    
+    pthread_t threads[MAX_THREADS];
+    ThreadWork thread_work[MAX_THREADS];
+    
+    // Distribute sample rows so every block row belongs to exactly one thread
+    int sample_rows = (Height + step - 1) / step;
+    int base_rows_per_thread = sample_rows / num_threads;
+    int extra_rows = sample_rows % num_threads;
+    
+    int current_row = 0;
+    for (int t = 0; t < num_threads; t++) {
+        int this_thread_rows = base_rows_per_thread + (t < extra_rows ? 1 : 0);
+        
+        thread_work[t].start_row = current_row * step;
+        thread_work[t].end_row = (current_row + this_thread_rows) * step;
+        if (thread_work[t].end_row > Height) thread_work[t].end_row = Height;
+        thread_work[t].seed = seed;
+        thread_work[t].pattern_type = pattern_type;
+        thread_work[t].time_offset = time_offset;
+        thread_work[t].colour_time = colour_time;
+        thread_work[t].cancel = NULL;
+        thread_work[t].chaos = chaos;
+        thread_work[t].texture_buffer = NULL;
+        thread_work[t].frame = texture_data;
+        thread_work[t].step = step;
+        thread_work[t].slot = t;
+        
+        create_worker_thread(&threads[t], t, generate_progressive_thread, &thread_work[t]);
+        
+        current_row += this_thread_rows;
+    }
+    
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    upload_frame(texture_data);
+}
+
+// Restart progressive refinement after an interactive seed or pattern change
+void start_progressive_refinement() {
+    progressive_step = PROGRESSIVE_START_STEP;
+    progressive_request_time = get_current_time();
+}
+
+// Start rendering a frame into the given buffer; the workers run until render_job_wait()
+void render_job_start(RenderJob* job, unsigned long seed, PatternType pattern_type, float time_offset, uint8_t* frame) {
+    job->trace_id = ++render_job_count;
+    TRACE_ASYNC_BEGIN("render_frame", job->trace_id);
+    job->thread_count = num_threads;
+    job->cancel = false;
+    job->start_time = get_current_time();
+    palette_prepare();
+    
+    // A frozen field keeps its time; the palette still turns with time_offset
+    float colour_time = time_offset;
+    if (field_frozen) time_offset = frozen_field_time;
+    ChaosTerms chaos = lorenz_terms(seed, time_offset);
+    
+    // Calculate rows per thread, ensuring no gaps
+    int base_rows_per_thread = Height / job->thread_count;
+    int extra_rows = Height % job->thread_count;
+    
+    int current_row = 0;
+    for (int t = 0; t < job->thread_count; t++) {
+        // Calculate this thread's row count (distribute extra rows evenly)
+        int this_thread_rows = base_rows_per_thread + (t < extra_rows ? 1 : 0);
+        
+        // Set up thread work
+        ThreadWork* work = &job->thread_work[t];
+        work->start_row = current_row;
+        work->end_row = current_row + this_thread_rows;
+        work->seed = seed;
+        work->pattern_type = pattern_type;
+        work->time_offset = time_offset;
+        work->colour_time = colour_time;
+        work->cancel = &job->cancel;
+        work->chaos = chaos;
+        work->texture_buffer = NULL;
+        work->frame = frame;
+        work->step = 1;
+        work->slot = t;
+        // Snapshot the placement: a rebalance or key press may reassign worker_cpu[] while
+        // this frame is still rendering ahead
+        work->node = worker_cpu[t] >= 0 ? cpu_node[worker_cpu[t]] : -1;
+        
+        // Create thread
+        create_worker_thread(&job->threads[t], t, generate_art_thread, work);
+        
+        current_row += this_thread_rows;
+    }
+    job->active = true;
+}
+
+// Wait for all threads of a started frame to finish; each one merges its own band
+void render_job_wait(RenderJob* job) {
+    if (!job->active) return;
+    
+    double finish_time = job->start_time;
+    bool field_hit = true;
+    for (int t = 0; t < job->thread_count; t++) {
+        pthread_join(job->threads[t], NULL);
+        if (job->thread_work[t].finish_time > finish_time) {
+            finish_time = job->thread_work[t].finish_time;
+        }
+        field_hit = field_hit && job->thread_work[t].field_hit;
+    }
+    job->seconds = finish_time - job->start_time;
+    job->active = false;
+    if (!job->cancel) {
+        if (field_hit) {
+            field_cache_stats.hits++;
+        } else {
+            field_cache_stats.misses++;
+        }
+        timing_mark("first frame rendered");
+    }
+    TRACE_ASYNC_END("render_frame", job->trace_id);
+}
+
+// Abandon a started frame: the workers stop at their next row and are joined. The frame
+// buffer is left incomplete.
+void render_job_cancel(RenderJob* job) {
+    if (!job->active) return;
+    __atomic_store_n(&job->cancel, true, __ATOMIC_RELAXED);
+    render_job_wait(job);
+}
+
+// Render one frame into texture_data using the worker threads
+void render_frame(unsigned long seed, PatternType pattern_type, float time_offset) {
+    RenderJob job;
+    render_job_start(&job, seed, pattern_type, time_offset, texture_data);
+    render_job_wait(&job);
+}
+
+// Count a frame that actually reached the screen and print FPS once a second
+void count_displayed_frame() {
+    frameCount++;
+    int currentTime = glutGet(GLUT_ELAPSED_TIME);
+    if (currentTime - lastTime > 1000) {
+        fps = frameCount * 1000 / (currentTime - lastTime);
+        frameCount = 0;
+        lastTime = currentTime;
+        printf("FPS: %d\n", fps);
+    }
+}
+
+// Time bench_frames frames at the current settings and return frames per second
+double bench_run(int threads, bool pinned) {
+    num_threads = threads;
+    pin_workers = pinned;
+    assign_worker_cpus();
+    
+    // Start from fresh buffers so first-touch placement matches this configuration
+    release_frame_buffers();
+    pool_trim();
+    init_frame_buffers(Width, Height);
+    
+    render_frame(randseed, pattern_type, 0.0f);  // Warm-up frame allocates band buffers
+    double start = get_current_time();
+    for (int frame = 0; frame < bench_frames; frame++) {
+        render_frame(randseed, pattern_type, (frame + 1) * 0.05f);
+    }
+    double elapsed = get_current_time() - start;
+    return elapsed > 0.0 ? bench_frames / elapsed : 0.0;
+}
+
+// Column headings for print_counter_row
+void print_counter_header(const char* first, const char* second) {
+    printf("%-14s %-9s %8s %6s %10s %14s %14s %14s %14s\n", first, second,
+           "fps", "IPC", "cycles", "cache-misses", "branch-misses", "dTLB-misses", "L1D-misses");
+}
+
+// Print one row of counter results for a benchmark run
+void print_counter_row(const char* pattern, const char* color, double fps, CounterSample* total, double pixels) {
+    printf("%-14s %-9s %8.2f", pattern, color, fps);
+    if (counter_available[COUNTER_INSTRUCTIONS] && total->values[COUNTER_CYCLES] > 0) {
+        printf(" %6.2f", (double)total->values[COUNTER_INSTRUCTIONS] / total->values[COUNTER_CYCLES]);
+    } else {
+        printf(" %6s", "n/a");
+    }
+    if (counter_available[COUNTER_CYCLES]) {
+        printf(" %10.1f", total->values[COUNTER_CYCLES] / pixels);
+    } else {
+        printf(" %10s", "n/a");
+    }
+    for (int c = COUNTER_CACHE_MISSES; c <= COUNTER_L1D_MISSES; c++) {
+        if (counter_available[c]) {
+            printf(" %14.4f", total->values[c] / pixels);
+        } else {
+            printf(" %14s", "n/a");
+        }
+    }
+    printf("\n");
+}
+
+// Run a benchmark at the current settings with the counters on and sum the workers
+double bench_counted_run(CounterSample* total) {
+    memset(worker_counters, 0, sizeof(worker_counters));
+    use_counters = counter_available[COUNTER_CYCLES];
+    double fps = bench_run(num_threads, pin_workers);
+    use_counters = false;
+    
+    memset(total, 0, sizeof(*total));
+    for (int t = 0; t < num_threads; t++) {
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            total->values[c] += worker_counters[t].values[c];
+        }
+    }
+    return fps;
+}
+
+// Compare row-major band evaluation against Z-ordered tiles; counter columns are n/a
+// unless bench_counters() has probed them
+void bench_traversal() {
+    double pixels = (double)Width * Height * (bench_frames + 1);
+    TraversalMode saved_traversal = traversal_mode;
+    printf("\nTraversal, %s/%s:\n", pattern_type_name(pattern_type), color_mode_name(color_mode));
+    print_counter_header("Traversal", "");
+    for (int tiled = 0; tiled <= 1; tiled++) {
+        traversal_mode = tiled ? TRAVERSAL_TILED : TRAVERSAL_ROWS;
+        CounterSample total;
+        double fps = bench_counted_run(&total);
+        print_counter_row(traversal_mode_name(traversal_mode), "", fps, &total, pixels);
+    }
+    traversal_mode = saved_traversal;
+}
+
+// Sweep every pattern/colour combination with hardware counters, then compare colouring
+// through the per-thread band buffers against writing the shared frame directly
+void bench_counters() {
+    counters_probe();  // Counters that cannot be opened are reported as n/a
+    
+    PatternType saved_pattern = pattern_type;
+    ColorMode saved_color = color_mode;
+    double pixels = (double)Width * Height * (bench_frames + 1);  // Includes the warm-up frame
+    
+    printf("\nHardware counters, %d threads (per pixel):\n", num_threads);
+    print_counter_header("Pattern", "Color");
+    for (int p = ORIGINAL; p <= CELLULAR; p++) {
+        for (int c = COLOR_MODE_1; c <= COLOR_MODE_RAINBOW; c++) {
+            pattern_type = (PatternType)p;
+            color_mode = (ColorMode)c;
+            CounterSample total;
+            double fps = bench_counted_run(&total);
+            print_counter_row(pattern_type_name(pattern_type), color_mode_name(color_mode), fps, &total, pixels);
+        }
+    }
+    pattern_type = saved_pattern;
+    color_mode = saved_color;
+    
+    printf("\nBand buffers, %s/%s:\n", pattern_type_name(pattern_type), color_mode_name(color_mode));
+    print_counter_header("Bands", "");
+    for (int staged = 1; staged >= 0; staged--) {
+        staged_bands = staged;
+        CounterSample total;
+        double fps = bench_counted_run(&total);
+        print_counter_row(staged ? "staged" : "direct", "", fps, &total, pixels);
+    }
+    staged_bands = true;
+    
+    // Same run with the frame and band buffers on normal pages and on huge pages
+    HugePageMode saved_pages = huge_page_mode;
+    printf("\nPage size, %s/%s:\n", pattern_type_name(pattern_type), color_mode_name(color_mode));
+    print_counter_header("Pages", "");
+    for (int huge = 0; huge <= 1; huge++) {
+        huge_page_mode = huge ? (saved_pages == HUGE_PAGES_OFF ? HUGE_PAGES_AUTO : saved_pages) : HUGE_PAGES_OFF;
+        CounterSample total;
+        double fps = bench_counted_run(&total);
+        print_counter_row(huge ? "huge" : "normal", "", fps, &total, pixels);
+    }
+    huge_page_mode = saved_pages;
+    bench_traversal();
+}
+
+// Measure the fast tier's functions against double libm: sin and cos over |x| <= 1e4,
+// atan2 around the unit circle
+void print_fast_math_error() {
+    double sin_error = 0.0, cos_error = 0.0, atan2_error = 0.0;
+    for (int k = -4000000; k <= 4000000; k++) {
+        float x = k * (10000.0f / 4000000);
+        sin_error = fmax(sin_error, fabs(fast_sinf(x) - sin((double)x)));
+        cos_error = fmax(cos_error, fabs(fast_cosf(x) - cos((double)x)));
+    }
+    for (int k = 0; k < 2000000; k++) {
+        double angle = k * (2.0 * M_PI / 2000000) - M_PI;
+        float y = (float)sin(angle), x = (float)cos(angle);
+        double error = fabs(fast_atan2f(y, x) - atan2((double)y, (double)x));
+        if (error < M_PI) atan2_error = fmax(atan2_error, error);  // Not the wrap at -pi
+    }
+    printf("Fast tier max error: sin %.2g, cos %.2g (|x| <= 1e4), atan2 %.2g rad\n",
+           sin_error, cos_error, atan2_error);
+}
+
+// Render one frame per pattern at every precision tier and report the per-channel error
+// against the exact tier in 0-255 units, along with the render time of each tier
+void run_precision_report() {
+    size_t frame_bytes = frame_buffer_bytes();
+    uint8_t* reference = (uint8_t*)malloc(frame_bytes);
+    PatternType saved_pattern = pattern_type;
+    PrecisionMode saved_precision = precision_mode;
+    RandomnessMode saved_random = random_mode;
+    float time_offset = 1.0f;
+    
+    if (random_mode == ENHANCED_RANDOM) {
+        printf("Note: enhanced random mode adds per-pixel rand() noise; comparing in classic mode.\n");
+        random_mode = CLASSIC_RANDOM;
+    }
+    printf("Precision report: %dx%d, color %s, %d threads\n",
+           Width, Height, color_mode_name(color_mode), num_threads);
+    print_fast_math_error();
+    printf("%-14s %-9s %9s %6s %6s %6s %7s %7s %7s\n",
+           "Pattern", "Tier", "ms/frame", "max R", "max G", "max B", "mean R", "mean G", "mean B");
+    
+    for (int p = ORIGINAL; p <= (pattern_expr_source[0] ? PATTERN_EXPR : CELLULAR); p++) {
+        pattern_type = (PatternType)p;
+        for (int tier = PRECISION_EXACT; tier <= PRECISION_FAST; tier++) {
+            precision_mode = (PrecisionMode)tier;
+            double start = get_current_time();
+            render_frame(randseed, pattern_type, time_offset);
+            double ms = (get_current_time() - start) * 1000.0;
+            
+            if (tier == PRECISION_EXACT) {
+                memcpy(reference, texture_data, frame_bytes);
+            }
+            
+            int max_error[3] = {0, 0, 0};
+            double sum_error[3] = {0.0, 0.0, 0.0};
+            for (size_t k = 0; k < frame_bytes; k++) {
+                int error = abs((int)texture_data[k] - (int)reference[k]);
+                if (error > max_error[k % 3]) max_error[k % 3] = error;
+                sum_error[k % 3] += error;
+            }
+            double pixels = (double)Width * Height;
+            printf("%-14s %-9s %9.2f %6d %6d %6d %7.3f %7.3f %7.3f\n",
+                   pattern_type_name(pattern_type), precision_mode_name(precision_mode), ms,
+                   max_error[0], max_error[1], max_error[2],
+                   sum_error[0] / pixels, sum_error[1] / pixels, sum_error[2] / pixels);
+        }
+    }
+    
+    pattern_type = saved_pattern;
+    precision_mode = saved_precision;
+    random_mode = saved_random;
+    free(reference);
+}
+
+// Cheap statistics of a thumbnail, gathered while its pixels are written
+typedef struct {
+    unsigned long seed;
+    double entropy;       // Shannon entropy of the 64-bin (2 bits per channel) colour histogram, in bits
+    double edge_density;  // Fraction of pixels whose luma differs from the left or upper neighbour by > 32
+    bool degenerate;      // Blank, flat or dominated by one colour
+    double score;
+} SeedScore;
+
+// Shared state of an exploration run
+typedef struct {
+    int next_seed;        // Next unclaimed seed index
+    pthread_mutex_t lock;
+    unsigned long base;
+    int thumb_width, thumb_height, step;
+    SeedScore* scores;
+} ExploreState;
+
+typedef struct {
+    ExploreState* state;
+    int slot;
+} ExploreWork;
+
+// Seed number k of a run: a splitmix64 step, folded to 32 bits like the time-based seeds
+unsigned long explore_seed(unsigned long base, int k) {
+    uint64_t z = (uint64_t)base + (uint64_t)(k + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (unsigned long)((z ^ (z >> 31)) & 0xffffffffu);
+}
+
+// Render a thumbnail of seed (every step-th pixel of the full-size frame) into out, scoring
+// it as each pixel is shaded. row_seeds and prev_luma hold thumb_width entries.
+void render_scored_thumbnail(unsigned long seed, int thumb_width, int thumb_height, int step, uint8_t* out,
+                             unsigned long* row_seeds, uint8_t* prev_luma, SeedScore* score) {
+    uint32_t histogram[64] = {0};
+    uint32_t edges = 0;
+    ChaosTerms chaos = lorenz_terms_uncached(seed, EXPLORE_TIME);
+    
+    for (int y = 0; y < thumb_height; y++) {
+        pattern_row_seeds(pattern_type, 0, step, thumb_width, y * step, EXPLORE_TIME, seed, &chaos, row_seeds);
+        uint8_t left_luma = 0;
+        for (int x = 0; x < thumb_width; x++) {
+            uint8_t* rgb = &out[((size_t)y * thumb_width + x) * 3];
+            shade_pixel(row_seeds[x], EXPLORE_TIME, rgb);
+            
+            histogram[(rgb[0] >> 6) << 4 | (rgb[1] >> 6) << 2 | rgb[2] >> 6]++;
+            uint8_t luma = (uint8_t)((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+            if ((x > 0 && abs(luma - left_luma) > 32) || (y > 0 && abs(luma - prev_luma[x]) > 32)) {
+                edges++;
+            }
+            left_luma = luma;
+            prev_luma[x] = luma;
+        }
+    }
+    
+    double pixels = (double)thumb_width * thumb_height;
+    double entropy = 0.0;
+    uint32_t largest_bin = 0;
+    for (int b = 0; b < 64; b++) {
+        if (histogram[b] == 0) continue;
+        double p = histogram[b] / pixels;
+        entropy -= p * log2(p);
+        if (histogram[b] > largest_bin) largest_bin = histogram[b];
+    }
+    
+    score->seed = seed;
+    score->entropy = entropy;
+    score->edge_density = edges / pixels;
+    score->degenerate = entropy < 1.0 || largest_bin > 0.9 * pixels || score->edge_density < 0.002;
+    
+    // Reward colour variety and structure; edges on most pixels mean noise, not detail
+    double structure = score->edge_density < 0.1 ? score->edge_density / 0.1 :
+                       score->edge_density < 0.5 ? 1.0 : 2.0 * (1.0 - score->edge_density);
+    score->score = score->degenerate ? 0.0 : (entropy / 6.0) * structure;
+}
+
+// Exploration worker: claim batches of seeds until none are left
+void* explore_thread(void* arg) {
+    ExploreWork* work = (ExploreWork*)arg;
+    ExploreState* state = work->state;
+    TRACE_SET_SLOT(work->slot + 1);
+    
+    uint8_t* thumb = (uint8_t*)pool_alloc((size_t)state->thumb_width * state->thumb_height * 3);
+    unsigned long* row_seeds = (unsigned long*)malloc(state->thumb_width * sizeof(unsigned long));
+    uint8_t* prev_luma = (uint8_t*)malloc(state->thumb_width);
+    
+    for (;;) {
+        pthread_mutex_lock(&state->lock);
+        int first = state->next_seed;
+        state->next_seed += EXPLORE_BATCH;
+        pthread_mutex_unlock(&state->lock);
+        if (first >= explore_seeds) break;
+        
+        int last = first + EXPLORE_BATCH < explore_seeds ? first + EXPLORE_BATCH : explore_seeds;
+        TRACE_BEGIN("explore_batch");
+        for (int k = first; k < last; k++) {
+            render_scored_thumbnail(explore_seed(state->base, k), state->thumb_width, state->thumb_height,
+                                    state->step, thumb, row_seeds, prev_luma, &state->scores[k]);
+        }
+        TRACE_END("explore_batch");
+    }
+    
+    pool_free(thumb);
+    free(row_seeds);
+    free(prev_luma);
+    return NULL;
+}
+
+int compare_seed_scores(const void* a, const void* b) {
+    double sa = ((const SeedScore*)a)->score;
+    double sb = ((const SeedScore*)b)->score;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+// Write an RGB image as binary PPM
+bool write_ppm(const char* filename, const uint8_t* rgb, int width, int height) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(rgb, 3, (size_t)width * height, f) == (size_t)width * height;
+    return fclose(f) == 0 && ok;
+}
+
+// Explore mode: score explore_seeds seeds on thumbnails across the worker threads, print the
+// best explore_top and write their thumbnails to a contact sheet
+int run_explore(const char* sheet_filename) {
+    ExploreState state;
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.lock, NULL);
+    state.base = randseed;
+    state.step = Width > EXPLORE_THUMB_WIDTH ? Width / EXPLORE_THUMB_WIDTH : 1;
+    state.thumb_width = Width / state.step;
+    state.thumb_height = Height / state.step > 0 ? Height / state.step : 1;
+    state.scores = (SeedScore*)calloc(explore_seeds, sizeof(SeedScore));
+    palette_prepare();
+    
+    printf("Exploring %d seeds: pattern %s, color %s, %dx%d thumbnails of %dx%d, %d threads\n",
+           explore_seeds, pattern_type_name(pattern_type), color_mode_name(color_mode),
+           state.thumb_width, state.thumb_height, Width, Height, num_threads);
+    
+    double start = get_current_time();
+    pthread_t threads[MAX_THREADS];
+    ExploreWork work[MAX_THREADS];
+    for (int t = 0; t < num_threads; t++) {
+        work[t].state = &state;
+        work[t].slot = t;
+        create_worker_thread(&threads[t], t, explore_thread, &work[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double elapsed = get_current_time() - start;
+    
+    int degenerate = 0;
+    for (int k = 0; k < explore_seeds; k++) {
+        if (state.scores[k].degenerate) degenerate++;
+    }
+    printf("Scored %d seeds in %.2fs (%.0f seeds/s, %.1f Mpixels/s); %d degenerate\n", explore_seeds, elapsed,
+           elapsed > 0.0 ? explore_seeds / elapsed : 0.0,
+           elapsed > 0.0 ? (double)explore_seeds * state.thumb_width * state.thumb_height / elapsed / 1e6 : 0.0,
+           degenerate);
+    
+    qsort(state.scores, explore_seeds, sizeof(SeedScore), compare_seed_scores);
+    int top = explore_top < explore_seeds ? explore_top : explore_seeds;
+    
+    // Contact sheet: best seeds left to right, top to bottom, 4 pixel gaps
+    const int gap = 4;
+    int columns = top < 4 ? top : 4;
+    int rows = (top + columns - 1) / columns;
+    int sheet_width = columns * (state.thumb_width + gap) + gap;
+    int sheet_height = rows * (state.thumb_height + gap) + gap;
+    uint8_t* sheet = (uint8_t*)calloc((size_t)sheet_width * sheet_height, 3);
+    uint8_t* thumb = (uint8_t*)malloc((size_t)state.thumb_width * state.thumb_height * 3);
+    unsigned long* row_seeds = (unsigned long*)malloc(state.thumb_width * sizeof(unsigned long));
+    uint8_t* prev_luma = (uint8_t*)malloc(state.thumb_width);
+    
+    printf("%-5s %-12s %8s %8s %8s\n", "Rank", "Seed", "Score", "Entropy", "Edges");
+    for (int k = 0; k < top; k++) {
+        SeedScore* best = &state.scores[k];
+        printf("%-5d %-12lu %8.3f %8.2f %8.3f\n", k + 1, best->seed, best->score, best->entropy, best->edge_density);
+        
+        SeedScore again;
+        render_scored_thumbnail(best->seed, state.thumb_width, state.thumb_height, state.step, thumb,
+                                row_seeds, prev_luma, &again);
+        int x0 = gap + (k % columns) * (state.thumb_width + gap);
+        int y0 = gap + (k / columns) * (state.thumb_height + gap);
+        for (int y = 0; y < state.thumb_height; y++) {
+            memcpy(&sheet[((size_t)(y0 + y) * sheet_width + x0) * 3], &thumb[(size_t)y * state.thumb_width * 3],
+                   (size_t)state.thumb_width * 3);
+        }
+    }
+    
+    int result = 0;
+    if (write_ppm(sheet_filename, sheet, sheet_width, sheet_height)) {
+        printf("Contact sheet: %s (%d columns, rank order)\n", sheet_filename, columns);
+    } else {
+        fprintf(stderr, "Could not write contact sheet '%s'\n", sheet_filename);
+        result = 1;
+    }
+    
+    free(sheet);
+    free(thumb);
+    free(row_seeds);
+    free(prev_luma);
+    free(state.scores);
+    pthread_mutex_destroy(&state.lock);
+    return result;
+}
+
+// Time each built-in pattern against its @name expression form at the full thread count
+void bench_expressions() {
+    PatternType saved_pattern = pattern_type;
+    ExprProgram saved_program = pattern_program;
+    
+    printf("\nPattern expressions vs built-ins, %d threads (classic random mode forms, identical output "
+           "under balanced and fast precision)\n", num_threads);
+    printf("%-14s %12s %12s %8s\n", "Pattern", "Built-in fps", "Expr fps", "Ratio");
+    for (int p = ORIGINAL; p <= CELLULAR; p++) {
+        char name[32];
+        snprintf(name, sizeof(name), "@%s", pattern_type_name((PatternType)p));
+        if (!compile_pattern_expr(name, &pattern_program)) continue;
+        
+        pattern_type = (PatternType)p;
+        double builtin_fps = bench_run(num_threads, pin_workers);
+        pattern_type = PATTERN_EXPR;
+        double expr_fps = bench_run(num_threads, pin_workers);
+        printf("%-14s %12.2f %12.2f %7.2fx\n", name + 1, builtin_fps, expr_fps,
+               builtin_fps > 0.0 ? expr_fps / builtin_fps : 0.0);
+    }
+    
+    pattern_type = saved_pattern;
+    pattern_program = saved_program;
+}
+
+// Benchmark mode: compare unpinned and pinned scaling over thread counts up to -t
+void run_benchmark() {
+    int max_threads = num_threads;
+    bool want_counters = use_counters;
+    bool can_pin = false;
+#ifdef __linux__
+    can_pin = true;
+#endif
+    
+    printf("Benchmark: %dx%d, pattern %d, %d frames per run, %d NUMA node%s\n",
+           Width, Height, pattern_type, bench_frames, numa_node_count, numa_node_count == 1 ? "" : "s");
+    if (!can_pin) {
+        printf("CPU pinning is not supported on this platform; reporting unpinned scaling only\n");
+    }
+    use_counters = false;  // Scaling runs are wall-clock only
+    printf("%-8s %14s %14s %10s %10s\n", "Threads", "Unpinned fps", "Pinned fps", "Scaling", "Pin gain");
+    
+    double base_fps = 0.0;
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        
+        double unpinned = bench_run(threads, false);
+        double pinned = can_pin ? bench_run(threads, true) : 0.0;
+        if (threads == 1) base_fps = unpinned;
+        
+        double scaling = base_fps > 0.0 ? unpinned / base_fps : 0.0;
+        if (can_pin) {
+            printf("%-8d %14.2f %14.2f %9.2fx %9.2fx\n", threads, unpinned, pinned, scaling,
+                   unpinned > 0.0 ? pinned / unpinned : 0.0);
+        } else {
+            printf("%-8d %14.2f %14s %9.2fx %10s\n", threads, unpinned, "-", scaling, "-");
+        }
+        if (threads == max_threads) break;
+    }
+    
+    bench_expressions();
+    if (want_counters) {
+        bench_counters();
+    } else {
+        bench_traversal();
+    }
+    print_pool_stats();
+}
+
+// GLUT callback functions
+void display(void) {
+    int refined_step = progressive_step;
+    
+    if (refined_step > 0) {
+        // Drop any frame rendered ahead for the old seed or pattern
+        render_job_cancel(&render_ahead);
+        
+        // Hold the animation still while refining so earlier samples stay valid
+        generateArtProgressive(randseed, pattern_type, display_time_offset);
+    } else {
+        if (!texture_back) {
+            texture_back = (uint8_t*)pool_alloc(frame_buffer_bytes());
+        }
+        if (!render_ahead.active) {
+            display_time_offset += 0.05f;
+            render_job_start(&render_ahead, randseed, pattern_type, display_time_offset, texture_back);
+        }
+        
+        // Frame N is ready in the back buffer; make it the displayed frame
+        render_job_wait(&render_ahead);
+        uint8_t* finished = texture_back;
+        texture_back = texture_data;
+        texture_data = finished;
+        
+        // Workers fill frame N+1 while frame N streams to the GPU and is drawn
+        display_time_offset += 0.05f;
+        render_job_start(&render_ahead, randseed, pattern_type, display_time_offset, texture_back);
+        upload_frame(texture_data);
+    }
+    
+    // Clear screen
+    clearScreen();
+    
+    // Draw textured quad
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(Width, 0.0f);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(Width, Height);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, Height);
+    glEnd();
+    
+    // The only swap of the frame
+    glutSwapBuffers();
+    count_displayed_frame();
+    timing_mark("first frame displayed");
+    print_timings();
+    
+    if (refined_step > 0) {
+        double elapsed_ms = (get_current_time() - progressive_request_time) * 1000.0;
+        if (refined_step == PROGRESSIVE_START_STEP) {
+            glFinish();  // Count the preview as visible only once the GPU has it
+            elapsed_ms = (get_current_time() - progressive_request_time) * 1000.0;
+            printf("Preview: first frame (1/%d resolution) in %.2f ms\n", refined_step, elapsed_ms);
+        }
+        progressive_step = refined_step / 2;
+        if (progressive_step == 0) {
+            printf("Preview: fully refined in %.2f ms\n", elapsed_ms);
+        }
+    }
+}
+
+void cleanup() {
+    render_job_cancel(&render_ahead);
+    print_field_cache_stats();
+    print_timings();
+    
+    // Free the frame and thread texture buffers
+    release_frame_buffers();
+    pool_trim();
+    
+    if (texture_id) {
+        glDeleteTextures(1, &texture_id);
+        glDeleteBuffers(2, pbo_ids);
+    }
+    
+#ifdef ARTMAKER_TRACE
+    if (trace_filename) {
+        trace_write(trace_filename);
+        trace_filename = NULL;
+    }
+#endif
+}
+
+void keyboard(unsigned char key, int x, int y) {
+    if (key == 27) { // ESC key
+        cleanup();
+        exit(0);
+    } else if (key == ' ') {
+        randseed = (unsigned long)time(NULL);
+        start_progressive_refinement();
+    } else if (key >= '0' && key <= '9') {
+        // Map number keys to patterns
+        switch(key) {
+            case '0': pattern_type = ORIGINAL; break;
+            case '1': pattern_type = POLAR; break;
+            case '2': pattern_type = TRIGONOMETRIC; break;
+            case '3': pattern_type = FRACTAL; break;
+            case '4': pattern_type = WAVE_INTERFERENCE; break;
+            case '5': pattern_type = WAVE2; break;
+            case '6': pattern_type = VORTEX; break;
+            case '7': pattern_type = KALEIDOSCOPE; break;
+            case '8': pattern_type = PSYCHEDELIC; break;
+            case '9': pattern_type = CELLULAR; break;
+            default: return;
+        }
+        start_progressive_refinement();
+        printf("Switched to pattern: %s\n", 
+            pattern_type == ORIGINAL ? "Original" :
+            pattern_type == POLAR ? "Polar" :
+            pattern_type == TRIGONOMETRIC ? "Trigonometric" :
+            pattern_type == FRACTAL ? "Fractal" :
+            pattern_type == WAVE_INTERFERENCE ? "Wave Interference" :
+            pattern_type == WAVE2 ? "Wave 2" :
+            pattern_type == VORTEX ? "Vortex" :
+            pattern_type == KALEIDOSCOPE ? "Kaleidoscope" :
+            pattern_type == PSYCHEDELIC ? "Psychedelic" :
+            pattern_type == CELLULAR ? "Cellular" : "Unknown");
+    } else if ((key == 'e' || key == 'E') && pattern_expr_source[0]) {
+        pattern_type = PATTERN_EXPR;
+        start_progressive_refinement();
+        printf("Switched to pattern expression: %s\n", pattern_expr_source);
+    } else if (key == 'c' || key == 'C') {
+        // The frame rendering ahead reads the colour mode and palette; let it finish first
+        render_job_wait(&render_ahead);
+        
+        // Cycle through color modes, including the loaded palette if there is one
+        color_mode = (ColorMode)((color_mode + 1) % COLOR_MODE_COUNT);
+        if (color_mode == COLOR_MODE_PALETTE && palette_file_size == 0) {
+            color_mode = COLOR_MODE_1;
+        }
+        printf("Switched to %s mode\n", 
+            color_mode == COLOR_MODE_1 ? "original RGB" : 
+            color_mode == COLOR_MODE_2 ? "enhanced color" : 
+            color_mode == COLOR_MODE_MONO ? "monochrome" :
+            color_mode == COLOR_MODE_RAINBOW ? "Rainbow Wave palette" :
+            color_mode == COLOR_MODE_PALETTE ? palette_path :
+            color_mode == COLOR_MODE_FIRE ? "fire palette" : "ocean palette");
+    } else if (key == 'f' || key == 'F') {
+        // Freeze the pattern field; the palette keeps rotating over it
+        field_frozen = !field_frozen;
+        frozen_field_time = display_time_offset;
+        printf("Pattern field %s\n", field_frozen ? "frozen" : "animating");
+    } else if (key == 'r' || key == 'R') {
+        render_job_wait(&render_ahead);  // Workers read the random mode per pixel
+        
+        // Cycle through random modes
+        random_mode = (RandomnessMode)((random_mode + 1) % 3);
+        printf("Switched to %s mode\n", 
+            random_mode == CLASSIC_RANDOM ? "classic random" : 
+            random_mode == ENHANCED_RANDOM ? "enhanced random" :
+            "Lorenz chaos");
+    } else if (key == '+' || key == '=') {
+        // Increase number of threads
+        if (num_threads < MAX_THREADS) {
+            num_threads++;
+            assign_worker_cpus();
+            printf("Increased to %d threads\n", num_threads);
+        } else {
+            printf("Already at maximum thread count: %d\n", MAX_THREADS);
+        }
+    } else if (key == '-' || key == '_') {
+        // Decrease number of threads
+        if (num_threads > 1) {
+            num_threads--;
+            assign_worker_cpus();
+            printf("Decreased to %d threads\n", num_threads);
+        } else {
+            printf("Already at minimum thread count: 1\n");
+        }
+    } else if (key == 'h' || key == 'H') {
+        // Print pattern mapping help
+        printf("\nPattern Mapping:\n");
+        printf("0: Original\n");
+        printf("1: Polar\n");
+        printf("2: Trigonometric\n");
+        printf("3: Fractal\n");
+        printf("4: Wave Interference\n");
+        printf("5: Wave 2\n");
+        printf("6: Vortex\n");
+        printf("7: Kaleidoscope\n");
+        printf("8: Psychedelic\n");
+        printf("9: Cellular\n");
+        if (pattern_expr_source[0]) {
+            printf("E: %s\n", pattern_expr_source);
+        }
+    } else {
+        // Generate new art with current pattern type but different seed
+        randseed = randseed | (key * 10);
+    }
+}
+
+void idle(void) {
+    display();
+}
+
+// Function to print progress
+void print_progress(int current_frame, int total_frames, double start_time) {
+    double current_time = get_current_time();
+    double elapsed = current_time - start_time;
+    double progress = (double)current_frame / total_frames;
+    double estimated_total = elapsed / progress;
+    double remaining = estimated_total - elapsed;
+    
+    printf("\rProgress: %d/%d frames (%.1f%%) - Elapsed: %.1fs - Remaining: %.1fs", 
+           current_frame, total_frames, progress * 100, 
+           elapsed, remaining);
+    fflush(stdout);
+}
+
+// Initialize video encoding context
+VideoContext* init_video_encoder(const char* filename, int width, int height, int framerate) {
+    VideoContext* ctx = (VideoContext*)calloc(1, sizeof(VideoContext));
+    ctx->rgb_linesize = padded_pitch(width) * 3;
+    
+    // Allocate format context
+    avformat_alloc_output_context2(&ctx->format_context, NULL, NULL, filename);
+    if (!ctx->format_context) {
+        fprintf(stderr, "Could not create output context\n");
+        return NULL;
+    }
+    
+    // Find the h264 encoder
+    const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec) {
+        fprintf(stderr, "Codec not found\n");
+        return NULL;
+    }
+    
+    // Create new video stream
+    ctx->video_stream = avformat_new_stream(ctx->format_context, codec);
+    if (!ctx->video_stream) {
+        fprintf(stderr, "Could not allocate stream\n");
+        return NULL;
+    }
+    
+    // Allocate codec context
+    ctx->codec_context = avcodec_alloc_context3(codec);
+    if (!ctx->codec_context) {
+        fprintf(stderr, "Could not allocate video codec context\n");
+        return NULL;
+    }
+    
+    // Set codec parameters
+    ctx->codec_context->bit_rate = 2000000;  // Reduced to 2Mbps for reasonable file size
+    ctx->codec_context->width = width;
+    ctx->codec_context->height = height;
+    ctx->codec_context->time_base = (AVRational){1, framerate};
+    ctx->codec_context->framerate = (AVRational){framerate, 1};
+    ctx->codec_context->gop_size = VIDEO_GOP_SIZE;  // Increased GOP size for better compression
+    ctx->codec_context->max_b_frames = 2;  // Increased B-frames
+    ctx->codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    if (encoder_threads > 0) {
+        ctx->codec_context->thread_count = encoder_threads;
+        ctx->codec_context->thread_type = FF_THREAD_FRAME;
+    }
+    
+    // Set x264 specific encoding parameters for high quality
+    AVDictionary *param = NULL;
+    av_dict_set(&param, "preset", "faster", 0);  // Faster encoding, artificial content doesn't benefit much from slow
+    av_dict_set(&param, "tune", "animation", 0);  // Optimize for animation content
+    av_dict_set(&param, "crf", "28", 0);  // Changed to 28 for good quality with much smaller file size
+    
+    // Set stream parameters
+    avcodec_parameters_from_context(ctx->video_stream->codecpar, ctx->codec_context);
+    
+    // Open codec with quality parameters
+    if (avcodec_open2(ctx->codec_context, codec, &param) < 0) {
+        fprintf(stderr, "Could not open codec\n");
+        return NULL;
+    }
+    av_dict_free(&param);
+    
+    // Open output file
+    if (avio_open(&ctx->format_context->pb, filename, AVIO_FLAG_WRITE) < 0) {
+        fprintf(stderr, "Could not open output file '%s'\n", filename);
+        return NULL;
+    }
+    
+    // Write format header
+    if (avformat_write_header(ctx->format_context, NULL) < 0) {
+        fprintf(stderr, "Error occurred when writing header\n");
+        return NULL;
+    }
+    
+    // Allocate frame
+    ctx->frame = av_frame_alloc();
+    ctx->frame->format = ctx->codec_context->pix_fmt;
+    ctx->frame->width = width;
+    ctx->frame->height = height;
+    
+    if (av_frame_get_buffer(ctx->frame, 0) < 0) {
+        fprintf(stderr, "Could not allocate frame data\n");
+        return NULL;
+    }
+    
+    // Initialize scaling context
+    ctx->sws_context = sws_getContext(width, height, AV_PIX_FMT_RGB24,
+                                    width, height, AV_PIX_FMT_YUV420P,
+                                    SWS_BILINEAR,  // Simple bilinear filtering is sufficient for 1:1 color conversion
+                                    NULL, NULL, NULL);
+    
+    if (!ctx->sws_context) {
+        fprintf(stderr, "Could not initialize scaling context\n");
+        return NULL;
+    }
+    
+    return ctx;
+}
 
-            case KALEIDOSCOPE: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float angle = fmodf(atan2f(dy, dx) + time_offset + random_factor, M_PI/4);
-                float distance = sqrtf(dx*dx + dy*dy);
-                float kaleid = sinf(angle * 8 + distance * 0.1f + random_factor) * cosf(distance * 0.05f - time_offset * 2 + random_factor);
-                return base_seed | ((int)(kaleid * 1000) * (int)(distance * 0.1f)) ^ ((int)(random_factor * 1000));
-            }
+// An encoder being opened on a background thread, so the codec lookup, libx264 setup and
+// output file creation overlap the render of the first frames
+typedef struct {
+    pthread_t thread;
+    const char* filename;
+    int width, height, framerate;
+    int total_frames;
+    double start_time;
+    VideoContext* ctx;
+    bool joined;
+} EncoderOpen;
 
-            case CELLULAR: {
-                float cell_size = 50.0f * (1.0f + 0.5f * sinf(time_offset + noise));
-                int cell_x = (int)(i / cell_size);
-                int cell_y = (int)(j / cell_size);
-                float dx = i - (cell_x + 0.5f) * cell_size;
-                float dy = j - (cell_y + 0.5f) * cell_size;
-                float dist = sqrtf(dx*dx + dy*dy);
-                return base_seed | ((cell_x * 17 + cell_y * 31) ^ (int)(dist * sinf(time_offset * 2 + random_factor)));
-            }
+void* encoder_open_thread(void* arg) {
+    EncoderOpen* pending = (EncoderOpen*)arg;
+    pending->ctx = init_video_encoder(pending->filename, pending->width, pending->height, pending->framerate);
+    timing_mark("encoder opened (background)");
+    return NULL;
+}
 
-            case PSYCHEDELIC: {
-                float freq1 = 0.03f * (1.0f + 0.5f * sinf(time_offset + noise));
-                float freq2 = 0.02f * (1.0f + 0.5f * cosf(time_offset + noise));
-                float wave1 = sinf(i * freq1 + time_offset + random_factor) * cosf(j * freq2);
-                float wave2 = cosf(i * freq2 - time_offset - random_factor) * sinf(j * freq1);
-                float wave3 = sinf(sqrtf((i-centerX)*(i-centerX) + (j-centerY)*(j-centerY)) * 0.1f + random_factor);
-                return base_seed | ((int)(wave1 * 1000) ^ (int)(wave2 * 1000) ^ (int)(wave3 * 1000));
-            }
+void encoder_open_start(EncoderOpen* pending, const char* filename, int width, int height, int framerate,
+                        int total_frames) {
+    pending->filename = filename;
+    pending->width = width;
+    pending->height = height;
+    pending->framerate = framerate;
+    pending->total_frames = total_frames;
+    pending->start_time = get_current_time();
+    pending->ctx = NULL;
+    pending->joined = false;
+    timing_mark("encoder open started");
+    pthread_create(&pending->thread, NULL, encoder_open_thread, pending);
+}
 
-            default:
-                return base_seed;
+// The opened encoder, NULL if it failed; waits for the open on first use
+VideoContext* encoder_open_wait(EncoderOpen* pending) {
+    if (!pending->joined) {
+        pthread_join(pending->thread, NULL);
+        pending->joined = true;
+        if (pending->ctx) {
+            pending->ctx->total_frames = pending->total_frames;
+            pending->ctx->start_time = pending->start_time;
+        }
+    }
+    return pending->ctx;
+}
+
+// Encode a frame
+int encode_frame(VideoContext* ctx, const uint8_t* rgb_data) {
+    // Convert RGB to YUV
+    const uint8_t* rgb_data_ptr[1] = { rgb_data };
+    int rgb_linesize[1] = { ctx->rgb_linesize };
+    if (rgb_data) {
+        TRACE_BEGIN("sws_scale");
+        sws_scale(ctx->sws_context, rgb_data_ptr, rgb_linesize, 0, ctx->codec_context->height,
+                  ctx->frame->data, ctx->frame->linesize);
+        TRACE_END("sws_scale");
+    }
+    
+    ctx->frame->pts = ctx->frame_count;
+    
+    // Send frame to encoder; a NULL frame puts the encoder into flush mode
+    TRACE_BEGIN("avcodec_send_frame");
+    int ret = avcodec_send_frame(ctx->codec_context, rgb_data ? ctx->frame : NULL);
+    TRACE_END("avcodec_send_frame");
+    if (ret < 0) {
+        fprintf(stderr, "Error sending frame for encoding\n");
+        return -1;
+    }
+    
+    while (ret >= 0) {
+        AVPacket *pkt = av_packet_alloc();
+        TRACE_BEGIN("avcodec_receive_packet");
+        ret = avcodec_receive_packet(ctx->codec_context, pkt);
+        TRACE_END("avcodec_receive_packet");
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            av_packet_free(&pkt);
+            break;
+        } else if (ret < 0) {
+            fprintf(stderr, "Error during encoding\n");
+            av_packet_free(&pkt);
+            return -1;
+        }
+        
+        pkt->stream_index = ctx->video_stream->index;
+        av_packet_rescale_ts(pkt, ctx->codec_context->time_base, ctx->video_stream->time_base);
+        TRACE_BEGIN("write_packet");
+        ret = av_interleaved_write_frame(ctx->format_context, pkt);
+        TRACE_END("write_packet");
+        av_packet_free(&pkt);
+        if (ret < 0) {
+            fprintf(stderr, "Error writing packet\n");
+            return -1;
         }
+        timing_mark("first packet written");
+    }
+    
+    return 0;
+}
+
+// Finalize video encoding
+void finalize_video_encoder(VideoContext* ctx) {
+    // Flush encoder
+    encode_frame(ctx, NULL);
+    
+    // Write trailer
+    av_write_trailer(ctx->format_context);
+    
+    // Close file
+    avio_closep(&ctx->format_context->pb);
+    
+    // Free resources
+    avcodec_free_context(&ctx->codec_context);
+    av_frame_free(&ctx->frame);
+    avformat_free_context(ctx->format_context);
+    sws_freeContext(ctx->sws_context);
+    free(ctx);
+}
+
+// Split the CPU budget: the encoder gets a quarter of the cores for its frame threads, fixed
+// once it is open, and the render pool gets the rest
+void apply_cpu_budget() {
+    encoder_threads = cpu_budget / 4 > 1 ? cpu_budget / 4 : 1;
+    num_threads = cpu_budget - encoder_threads;
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    printf("CPU budget: %d cores, %d render threads, %d encoder threads\n",
+           cpu_budget, num_threads, encoder_threads);
+}
+
+// Move one core toward the slower stage over the last GOP. The encoder's thread count
+// cannot change once it is open, so the render pool moves: it shrinks to leave cores to the
+// encoder while encoding is the bottleneck and grows into cores the encoder leaves idle
+// while rendering is.
+void rebalance_cpu_budget(double render_seconds, double encode_seconds) {
+    int max_render = cpu_budget - 1 < MAX_THREADS ? cpu_budget - 1 : MAX_THREADS;
+    if (encode_seconds > render_seconds * 1.1 && num_threads > 1) {
+        num_threads--;
+    } else if (render_seconds > encode_seconds * 1.1 && num_threads < max_render) {
+        num_threads++;
     } else {
-        // Classic random mode
-        switch(pattern_type) {
-            case ORIGINAL:
-                return base_seed | (i*j & (int)(i*cos(time_offset)*j));
-                
-            case POLAR: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float distance = sqrtf(dx*dx + dy*dy) / (sqrtf(Width*Width + Height*Height) * 0.5f);
-                float angle = atan2f(dy, dx);
-                float pattern = (sinf(distance * 10.0f + time_offset) * 0.5f + 0.5f) * 
-                              (sinf(angle * 4.0f + time_offset) * 0.5f + 0.5f);
-                return base_seed | ((int)(pattern * 1000));
+        return;
+    }
+    assign_worker_cpus();
+}
+
+// Per-stage throughput of the frames rendered and encoded so far
+void print_stage_report() {
+    VideoStageStats* s = &video_stage_stats;
+    if (s->frames == 0) return;
+    printf("Render: %.2f fps (%.1f ms/frame, %d threads at the end)\n",
+           s->render_seconds > 0.0 ? s->frames / s->render_seconds : 0.0,
+           s->render_seconds * 1000.0 / s->frames, num_threads);
+    printf("Encode: %.2f fps (%.1f ms/frame, ", s->encode_seconds > 0.0 ? s->frames / s->encode_seconds : 0.0,
+           s->encode_seconds * 1000.0 / s->frames);
+    if (encoder_threads > 0) {
+        printf("%d encoder threads)\n", encoder_threads);
+    } else {
+        printf("encoder threads chosen by libx264)\n");
+    }
+    printf("Waiting on render: %.1f ms/frame - %s-bound\n", s->wait_seconds * 1000.0 / s->frames,
+           s->wait_seconds > s->encode_seconds * 0.1 ? "render" : "encode");
+}
+
+// Render frames [first_frame, first_frame + frame_count) and encode them into ctx. Each
+// frame's time offset depends only on its index, so any range renders the same frames
+// whether it is encoded locally, by a farm worker or after a resume. With ctx NULL, the
+// encoder is still being opened by pending and is waited for when the first frame is ready.
+int render_video_range(VideoContext* ctx, EncoderOpen* pending, int first_frame, int frame_count,
+                       bool show_progress) {
+    if (!texture_back) {
+        texture_back = (uint8_t*)pool_alloc(frame_buffer_bytes());
+    }
+    
+    // Precompute the Lorenz trajectory for the whole range up front
+    if (random_mode == LORENZ_RANDOM) {
+        lorenz_prepare(randseed, first_frame + frame_count);
+    }
+    
+    // Frame k+1 renders into texture_back while frame k is converted and encoded
+    RenderJob job;
+    double window_render = 0.0, window_encode = 0.0;
+    int window_frames = 0;
+    render_job_start(&job, randseed, pattern_type, first_frame * VIDEO_TIME_STEP, texture_back);
+    
+    for (int k = 0; k < frame_count; k++) {
+        TRACE_BEGIN("frame");
+        double wait_start = get_current_time();
+        render_job_wait(&job);
+        video_stage_stats.wait_seconds += get_current_time() - wait_start;
+        video_stage_stats.render_seconds += job.seconds;
+        window_render += job.seconds;
+        
+        uint8_t* finished = texture_back;
+        texture_back = texture_data;
+        texture_data = finished;
+        if (k + 1 < frame_count) {
+            render_job_start(&job, randseed, pattern_type, (first_frame + k + 1) * VIDEO_TIME_STEP, texture_back);
+        }
+        
+        if (!ctx && !(ctx = encoder_open_wait(pending))) {
+            fprintf(stderr, "Failed to initialize video encoder\n");
+            render_job_wait(&job);
+            TRACE_END("frame");
+            return -1;
+        }
+        
+        double encode_start = get_current_time();
+        if (encode_frame(ctx, texture_data) < 0) {
+            fprintf(stderr, "Error encoding frame %d\n", first_frame + k);
+            render_job_wait(&job);
+            TRACE_END("frame");
+            return -1;
+        }
+        double encode_seconds = get_current_time() - encode_start;
+        video_stage_stats.encode_seconds += encode_seconds;
+        video_stage_stats.frames++;
+        window_encode += encode_seconds;
+        
+        if (cpu_budget > 0 && ++window_frames == VIDEO_GOP_SIZE) {
+            rebalance_cpu_budget(window_render, window_encode);
+            window_render = window_encode = 0.0;
+            window_frames = 0;
+        }
+        
+        if (show_progress) {
+            print_progress(k + 1, frame_count, ctx->start_time);
+        }
+        ctx->frame_count++;
+        TRACE_END("frame");
+    }
+    return 0;
+}
+
+// Encode frames [first_frame, first_frame + frame_count) into a standalone file
+bool encode_video_segment(const char* filename, int first_frame, int frame_count, int framerate) {
+    EncoderOpen pending;
+    encoder_open_start(&pending, filename, Width, Height, framerate, frame_count);
+    
+    int ret = render_video_range(NULL, &pending, first_frame, frame_count, false);
+    VideoContext* ctx = encoder_open_wait(&pending);
+    if (!ctx) {
+        return false;
+    }
+    finalize_video_encoder(ctx);
+    return ret == 0;
+}
+
+// Join independently encoded segments into one file without re-encoding. Segment k starts at
+// frame first_frames[k]; packet timestamps are shifted by that offset, which keeps decode
+// order monotonic because every segment is encoded with the same settings.
+int remux_segments(char** segment_files, const int* first_frames, int count,
+                   const char* output_filename, int framerate) {
+    AVFormatContext* out = NULL;
+    AVStream* out_stream = NULL;
+    int64_t last_dts = AV_NOPTS_VALUE;
+    int result = -1;
+    
+    for (int k = 0; k < count; k++) {
+        AVFormatContext* in = NULL;
+        if (avformat_open_input(&in, segment_files[k], NULL, NULL) < 0) {
+            fprintf(stderr, "Could not open segment '%s'\n", segment_files[k]);
+            goto done;
+        }
+        if (avformat_find_stream_info(in, NULL) < 0 || in->nb_streams < 1) {
+            fprintf(stderr, "Could not read stream info from '%s'\n", segment_files[k]);
+            avformat_close_input(&in);
+            goto done;
+        }
+        AVStream* in_stream = in->streams[0];
+        
+        if (!out) {
+            avformat_alloc_output_context2(&out, NULL, NULL, output_filename);
+            if (!out) {
+                fprintf(stderr, "Could not create output context\n");
+                avformat_close_input(&in);
+                goto done;
             }
-                
-            case TRIGONOMETRIC:
-                return base_seed | ((int)(sinf(i*0.05 + time_offset)*100) * 
-                                  (int)(cosf(j*0.05 - time_offset)*100));
-                
-            case FRACTAL: {
-                float scale = 8.0f + sinf(time_offset) * 4.0f;
-                return base_seed | ((i*j & i*j) ^ ((int)(i/scale)*(int)(j/scale) & 
-                                  (int)(i/scale)*(int)(j/scale)));
+            out_stream = avformat_new_stream(out, NULL);
+            avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
+            out_stream->codecpar->codec_tag = 0;
+            out_stream->time_base = in_stream->time_base;
+            
+            if (avio_open(&out->pb, output_filename, AVIO_FLAG_WRITE) < 0 ||
+                avformat_write_header(out, NULL) < 0) {
+                fprintf(stderr, "Could not write output file '%s'\n", output_filename);
+                avformat_close_input(&in);
+                goto done;
             }
-                
-            case WAVE_INTERFERENCE: {
-                float wave1 = sinf(i*0.05 + j*0.05 + time_offset) * 100;
-                float wave2 = sinf(i*0.08 - j*0.03 - time_offset*1.5) * 100;
-                float wave3 = sinf(sqrtf(powf(i-Width/2, 2) + powf(j-Height/2, 2)) * 0.1 + time_offset*0.5) * 100;
-                return base_seed | ((int)(wave1 + wave2 + wave3));
+        }
+        
+        int64_t offset = av_rescale_q(first_frames[k], (AVRational){1, framerate}, out_stream->time_base);
+        AVPacket* pkt = av_packet_alloc();
+        while (av_read_frame(in, pkt) >= 0) {
+            if (pkt->stream_index != in_stream->index) {
+                av_packet_unref(pkt);
+                continue;
             }
-                
-            case WAVE2: {
-                float wave_x = sinf(j * 0.1f + time_offset * 2.0f) * 10;
-                float wave_y = cosf(i * 0.1f + time_offset * 2.0f) * 10;
-                int x_new = i + (int)wave_x;
-                int y_new = j + (int)wave_y;
-                return base_seed | (x_new * y_new);
+            av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+            if (pkt->pts != AV_NOPTS_VALUE) pkt->pts += offset;
+            if (pkt->dts != AV_NOPTS_VALUE) {
+                pkt->dts += offset;
+                if (last_dts != AV_NOPTS_VALUE && pkt->dts <= last_dts) pkt->dts = last_dts + 1;
+                last_dts = pkt->dts;
             }
-                
-            case VORTEX: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float angle = atan2f(dy, dx);
-                float distance = sqrtf(dx*dx + dy*dy);
-                float spiral = angle + distance * 0.02f + time_offset;
-                float vortex = sinf(spiral) * cosf(distance * 0.05f + time_offset);
-                return base_seed | ((int)(vortex * 1000) ^ (int)(distance));
+            pkt->stream_index = out_stream->index;
+            pkt->pos = -1;
+            
+            if (av_interleaved_write_frame(out, pkt) < 0) {
+                fprintf(stderr, "Error writing packet from '%s'\n", segment_files[k]);
+                av_packet_free(&pkt);
+                avformat_close_input(&in);
+                goto done;
             }
+        }
+        av_packet_free(&pkt);
+        avformat_close_input(&in);
+    }
+    result = 0;
+    
+done:
+    if (out) {
+        if (out->pb) {
+            if (result == 0) av_write_trailer(out);
+            avio_closep(&out->pb);
+        }
+        avformat_free_context(out);
+    }
+    return result;
+}
 
-            case KALEIDOSCOPE: {
-                float dx = i - centerX;
-                float dy = j - centerY;
-                float angle = fmodf(atan2f(dy, dx) + time_offset, M_PI/4);
-                float distance = sqrtf(dx*dx + dy*dy);
-                float kaleid = sinf(angle * 8 + distance * 0.1f) * cosf(distance * 0.05f - time_offset * 2);
-                return base_seed | ((int)(kaleid * 1000) * (int)(distance * 0.1f));
-            }
+// Area-averaging reducer from the rendered frame to a smaller rendition. Each output pixel
+// is the mean of the box of source pixels it covers: source rows are summed into row_sum with
+// a plain byte-add loop the compiler vectorizes, then each output pixel sums its columns.
+typedef struct {
+    int src_width, src_height;
+    int dst_width, dst_height;
+    int* col_start;     // First source column of each output column, plus an end entry
+    uint32_t* row_sum;  // Column sums of the current output row's source rows, 3 per pixel
+} FrameReducer;
 
-            case CELLULAR: {
-                float cell_size = 50.0f * (1.0f + 0.5f * sinf(time_offset));
-                int cell_x = (int)(i / cell_size);
-                int cell_y = (int)(j / cell_size);
-                float dx = i - (cell_x + 0.5f) * cell_size;
-                float dy = j - (cell_y + 0.5f) * cell_size;
-                float dist = sqrtf(dx*dx + dy*dy);
-                return base_seed | ((cell_x * 17 + cell_y * 31) ^ (int)(dist * sinf(time_offset * 2)));
-            }
+void reducer_init(FrameReducer* reducer, int src_width, int src_height, int dst_width, int dst_height) {
+    reducer->src_width = src_width;
+    reducer->src_height = src_height;
+    reducer->dst_width = dst_width;
+    reducer->dst_height = dst_height;
+    reducer->col_start = (int*)malloc((dst_width + 1) * sizeof(int));
+    for (int x = 0; x <= dst_width; x++) {
+        reducer->col_start[x] = (int)((long)x * src_width / dst_width);
+    }
+    reducer->row_sum = (uint32_t*)malloc((size_t)src_width * 3 * sizeof(uint32_t));
+}
 
-            case PSYCHEDELIC: {
-                float freq1 = 0.03f * (1.0f + 0.5f * sinf(time_offset));
-                float freq2 = 0.02f * (1.0f + 0.5f * cosf(time_offset));
-                float wave1 = sinf(i * freq1 + time_offset) * cosf(j * freq2);
-                float wave2 = cosf(i * freq2 - time_offset) * sinf(j * freq1);
-                float wave3 = sinf(sqrtf((i-centerX)*(i-centerX) + (j-centerY)*(j-centerY)) * 0.1f);
-                return base_seed | ((int)(wave1 * 1000) ^ (int)(wave2 * 1000) ^ (int)(wave3 * 1000));
-            }
+void reducer_free(FrameReducer* reducer) {
+    free(reducer->col_start);
+    free(reducer->row_sum);
+}
 
-            default:
-                return base_seed;
+// Reduce a frame with padded_pitch(src_width) rows into one with padded_pitch(dst_width) rows
+void reduce_frame(FrameReducer* reducer, const uint8_t* src, uint8_t* dst) {
+    size_t src_stride = (size_t)padded_pitch(reducer->src_width) * 3;
+    size_t dst_stride = (size_t)padded_pitch(reducer->dst_width) * 3;
+    int row_values = reducer->src_width * 3;
+    uint32_t* restrict row_sum = reducer->row_sum;
+    
+    for (int y = 0; y < reducer->dst_height; y++) {
+        int y0 = (int)((long)y * reducer->src_height / reducer->dst_height);
+        int y1 = (int)((long)(y + 1) * reducer->src_height / reducer->dst_height);
+        
+        memset(row_sum, 0, row_values * sizeof(uint32_t));
+        for (int sy = y0; sy < y1; sy++) {
+            const uint8_t* restrict row = src + sy * src_stride;
+            for (int k = 0; k < row_values; k++) {
+                row_sum[k] += row[k];
+            }
+        }
+        
+        uint8_t* out = dst + y * dst_stride;
+        for (int x = 0; x < reducer->dst_width; x++) {
+            int x0 = reducer->col_start[x];
+            int x1 = reducer->col_start[x + 1];
+            uint32_t r = 0, g = 0, b = 0;
+            for (int sx = x0; sx < x1; sx++) {
+                r += row_sum[sx * 3];
+                g += row_sum[sx * 3 + 1];
+                b += row_sum[sx * 3 + 2];
+            }
+            uint32_t count = (uint32_t)((x1 - x0) * (y1 - y0));
+            out[x * 3] = (uint8_t)((r + count / 2) / count);
+            out[x * 3 + 1] = (uint8_t)((g + count / 2) / count);
+            out[x * 3 + 2] = (uint8_t)((b + count / 2) / count);
         }
     }
-    return base_seed;
 }
 
-// Thread function for parallel processing of art generation
-void* generate_art_thread(void* arg) {
-    ThreadWork* work = (ThreadWork*)arg;
-    
-    // Clear the thread's buffer first
-    memset(work->texture_buffer, 0, Width * Height * 3);
+// Rendered frames shared by all rendition encoders. A slot is reused once every encoder has
+// released it.
+typedef struct {
+    uint8_t* frames[RENDITION_RING_SLOTS];
+    int pending[RENDITION_RING_SLOTS];  // Encoders still reading each slot
+    int produced;                       // Frames rendered so far
+    int total_frames;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} FrameRing;
+
+typedef struct {
+    int width, height;
+    char filename[512];
+    VideoContext* ctx;
+    FrameReducer reducer;  // Unused by the full-size rendition
+    bool full_size;        // Encodes straight from the ring
+    uint8_t* frame;        // Reduced frame
+    FrameRing* ring;
+    int index;             // Trace slot offset among the rendition encoders
+    pthread_t thread;
+    bool failed;
+    double busy_seconds;   // Reducing and encoding
+} Rendition;
+
+void frame_ring_release(FrameRing* ring, int slot) {
+    pthread_mutex_lock(&ring->lock);
+    ring->pending[slot]--;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Encoder thread for one rendition: take each rendered frame from the ring, reduce it,
+// release the slot and encode
+void* rendition_encoder_thread(void* arg) {
+    Rendition* r = (Rendition*)arg;
+    FrameRing* ring = r->ring;
+    TRACE_SET_SLOT(MAX_THREADS + 1 + r->index);
     
-    for(int j = work->start_row; j < work->end_row; j++) {
-        for(int i = 0; i < Width; i++) {
-            // Generate pattern seed for this pixel
-            unsigned long pattern_seed = calculate_pattern_seed(i, j, work->pattern_type, 
-                                                             work->time_offset, Width, Height, work->seed);
-            srand(pattern_seed);
-            
-            float r, g, b;
-            float random_factor = (float)rand() / RAND_MAX;
-            
-            if (color_mode == COLOR_MODE_1) {
-                // Original color mode
-                float random_shift = random_factor * 0.2f - 0.1f;
-                r = ((pattern_seed % 256) / 255.0f + random_shift);
-                g = (((pattern_seed >> 8) % 256) / 255.0f + random_shift);
-                b = (((pattern_seed >> 16) % 256) / 255.0f + random_shift);
-                
-                // Add time-based color pulsing with random phase
-                float phase_shift = random_factor * M_PI;
-                r *= (0.7f + 0.3f * sinf(work->time_offset + phase_shift));
-                g *= (0.7f + 0.3f * sinf(work->time_offset + 2.094f + phase_shift));
-                b *= (0.7f + 0.3f * sinf(work->time_offset + 4.189f + phase_shift));
-            } else if (color_mode == COLOR_MODE_2) {
-                // Enhanced color mode
-                float base = (float)(pattern_seed % 1000) / 1000.0f;
-                r = base;
-                g = fmodf(base + 0.33f + 0.1f * sinf(work->time_offset + random_factor), 1.0f);
-                b = fmodf(base + 0.66f + 0.1f * cosf(work->time_offset + random_factor), 1.0f);
-                
-                float contrast = 0.3f;
-                r = 0.5f + (r - 0.5f) * (1.0f + contrast);
-                g = 0.5f + (g - 0.5f) * (1.0f + contrast);
-                b = 0.5f + (b - 0.5f) * (1.0f + contrast);
-            } else { // COLOR_MODE_MONO
-                float intensity = (float)(pattern_seed % 1000) / 1000.0f;
-                intensity = intensity * 0.8f + 0.2f * sinf(work->time_offset + random_factor);
-                float contrast = 0.4f;
-                intensity = 0.5f + (intensity - 0.5f) * (1.0f + contrast);
-                r = g = b = intensity;
-            }
-            
-            // Clamp colors
-            r = fmaxf(0.0f, fminf(1.0f, r));
-            g = fmaxf(0.0f, fminf(1.0f, g));
-            b = fmaxf(0.0f, fminf(1.0f, b));
-            
-            // Write directly to the correct position in the buffer
-            int pixel_idx = (j * Width + i) * 3;
-            work->texture_buffer[pixel_idx] = (uint8_t)(r * 255.0f);
-            work->texture_buffer[pixel_idx + 1] = (uint8_t)(g * 255.0f);
-            work->texture_buffer[pixel_idx + 2] = (uint8_t)(b * 255.0f);
+    for (int k = 0; k < ring->total_frames; k++) {
+        int slot = k % RENDITION_RING_SLOTS;
+        pthread_mutex_lock(&ring->lock);
+        while (ring->produced <= k) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+        pthread_mutex_unlock(&ring->lock);
+        
+        double start = get_current_time();
+        if (r->full_size) {
+            // The colour conversion reads the ring frame, so the slot is held until it is done
+            if (!r->failed && encode_frame(r->ctx, ring->frames[slot]) < 0) r->failed = true;
+            frame_ring_release(ring, slot);
+        } else {
+            TRACE_BEGIN("reduce");
+            reduce_frame(&r->reducer, ring->frames[slot], r->frame);
+            TRACE_END("reduce");
+            frame_ring_release(ring, slot);
+            if (!r->failed && encode_frame(r->ctx, r->frame) < 0) r->failed = true;
         }
+        r->ctx->frame_count++;
+        r->busy_seconds += get_current_time() - start;
     }
     
+    finalize_video_encoder(r->ctx);
     return NULL;
 }
 
-// Modified generateArt function to use multiple threads
-void generateArt(unsigned long seed, PatternType pattern_type, float time_offset) {
-    // FPS calculation
-    frameCount++;
-    int currentTime = glutGet(GLUT_ELAPSED_TIME);
-    if (currentTime - lastTime > 1000) {
-        fps = frameCount * 1000 / (currentTime - lastTime);
-        frameCount = 0;
-        lastTime = currentTime;
-        printf("FPS: %d\n", fps);
+// Close the encoders already opened when a later one fails, before any frame is written, and
+// remove their header-only files
+void abandon_renditions(Rendition* renditions, int count) {
+    for (int k = 0; k < count; k++) {
+        Rendition* r = &renditions[k];
+        finalize_video_encoder(r->ctx);
+        remove(r->filename);
+        if (!r->full_size) {
+            reducer_free(&r->reducer);
+            pool_free(r->frame);
+        }
     }
+}
+
+// Render the video once at Width x Height and encode every -out-mode rendition from it, each
+// on its own encoder thread; output files get a _<height>p suffix
+int render_video_renditions(const char* output_filename, int total_frames, int framerate) {
+    Rendition renditions[MAX_RENDITIONS];
+    int count = 0;
+    const char* ext = strrchr(output_filename, '.');
+    int stem_len = ext ? (int)(ext - output_filename) : (int)strlen(output_filename);
     
-    srand(seed);
-    clearScreen();
-    
-    // Clear main texture buffer
-    memset(texture_data, 0, Width * Height * 3);
+    for (int k = 0; k < output_config.rendition_count; k++) {
+        int height = output_config.rendition_heights[k];
+        if (height > Height) {
+            printf("Skipping %dp rendition: it is taller than the %d rendered rows\n", height, Height);
+            continue;
+        }
+        
+        Rendition* r = &renditions[count];
+        memset(r, 0, sizeof(*r));
+        r->full_size = height == Height;
+        r->height = r->full_size ? Height : height & ~1;
+        r->width = r->full_size ? Width : (int)((long)Width * height / Height) & ~1;
+        snprintf(r->filename, sizeof(r->filename), "%.*s_%dp%s", stem_len, output_filename,
+                 height, ext ? ext : ".mp4");
+        r->ctx = init_video_encoder(r->filename, r->width, r->height, framerate);
+        if (!r->ctx) {
+            fprintf(stderr, "Failed to initialize video encoder for %s\n", r->filename);
+            abandon_renditions(renditions, count);
+            return 1;
+        }
+        r->index = count;
+        r->ctx->total_frames = total_frames;
+        if (!r->full_size) {
+            reducer_init(&r->reducer, Width, Height, r->width, r->height);
+            r->frame = (uint8_t*)pool_alloc((size_t)padded_pitch(r->width) * r->height * 3);
+        }
+        printf("Rendition %dx%d -> %s\n", r->width, r->height, r->filename);
+        count++;
+    }
+    if (count == 0) {
+        fprintf(stderr, "No renditions fit the %dx%d render\n", Width, Height);
+        return 1;
+    }
     
-    // Create threads and distribute work
-    pthread_t threads[MAX_THREADS];
-    ThreadWork thread_work[MAX_THREADS];
+    FrameRing ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.total_frames = total_frames;
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.cond, NULL);
+    for (int slot = 0; slot < RENDITION_RING_SLOTS; slot++) {
+        ring.frames[slot] = (uint8_t*)pool_alloc(frame_buffer_bytes());
+    }
+    for (int k = 0; k < count; k++) {
+        renditions[k].ring = &ring;
+        pthread_create(&renditions[k].thread, NULL, rendition_encoder_thread, &renditions[k]);
+    }
     
-    // Calculate rows per thread, ensuring no gaps
-    int base_rows_per_thread = Height / num_threads;
-    int extra_rows = Height % num_threads;
+    if (random_mode == LORENZ_RANDOM) {
+        lorenz_prepare(randseed, total_frames);
+    }
     
-    int current_row = 0;
-    for (int t = 0; t < num_threads; t++) {
-        // Calculate this thread's row count (distribute extra rows evenly)
-        int this_thread_rows = base_rows_per_thread + (t < extra_rows ? 1 : 0);
-        
-        // Set up thread work
-        thread_work[t].start_row = current_row;
-        thread_work[t].end_row = current_row + this_thread_rows;
-        thread_work[t].seed = seed;
-        thread_work[t].pattern_type = pattern_type;
-        thread_work[t].time_offset = time_offset;
-        thread_work[t].texture_buffer = thread_texture_buffers[t];
+    // Render each frame once into the next free ring slot
+    double start_time = get_current_time();
+    double render_seconds = 0.0;
+    for (int frame = 0; frame < total_frames; frame++) {
+        int slot = frame % RENDITION_RING_SLOTS;
+        pthread_mutex_lock(&ring.lock);
+        while (ring.pending[slot] > 0) {
+            pthread_cond_wait(&ring.cond, &ring.lock);
+        }
+        pthread_mutex_unlock(&ring.lock);
         
-        // Create thread
-        pthread_create(&threads[t], NULL, generate_art_thread, &thread_work[t]);
+        RenderJob job;
+        render_job_start(&job, randseed, pattern_type, frame * VIDEO_TIME_STEP, ring.frames[slot]);
+        render_job_wait(&job);
+        render_seconds += job.seconds;
         
-        current_row += this_thread_rows;
+        pthread_mutex_lock(&ring.lock);
+        ring.pending[slot] = count;
+        ring.produced = frame + 1;
+        pthread_cond_broadcast(&ring.cond);
+        pthread_mutex_unlock(&ring.lock);
+        print_progress(frame + 1, total_frames, start_time);
     }
     
-    // Wait for all threads to finish and combine results
-    for (int t = 0; t < num_threads; t++) {
-        pthread_join(threads[t], NULL);
-        
-        // Copy only the rows this thread was responsible for
-        for (int j = thread_work[t].start_row; j < thread_work[t].end_row; j++) {
-            memcpy(&texture_data[j * Width * 3],
-                   &thread_texture_buffers[t][j * Width * 3],
-                   Width * 3);
-        }
+    printf("\nFinishing video encoding...\n");
+    int result = 0;
+    for (int k = 0; k < count; k++) {
+        pthread_join(renditions[k].thread, NULL);
     }
+    double elapsed = get_current_time() - start_time;
     
-    // Update texture
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, texture_data);
+    printf("Rendered %d frames once: %.2f fps render, %.1fs total\n", total_frames,
+           render_seconds > 0.0 ? total_frames / render_seconds : 0.0, elapsed);
+    for (int k = 0; k < count; k++) {
+        Rendition* r = &renditions[k];
+        printf("  %-24s %4dx%-4d %8.2f fps reduce+encode%s\n", r->filename, r->width, r->height,
+               r->busy_seconds > 0.0 ? total_frames / r->busy_seconds : 0.0, r->failed ? " (FAILED)" : "");
+        if (r->failed) result = 1;
+        if (!r->full_size) {
+            reducer_free(&r->reducer);
+            pool_free(r->frame);
+        }
+    }
     
-    glutSwapBuffers();
+    for (int slot = 0; slot < RENDITION_RING_SLOTS; slot++) {
+        pool_free(ring.frames[slot]);
+    }
+    pthread_mutex_destroy(&ring.lock);
+    pthread_cond_destroy(&ring.cond);
+    return result;
 }
 
-// GLUT callback functions
-void display(void) {
-    static float time_offset = 0.0f;
-    time_offset += 0.05f;
-    
-    // Generate art into texture
-    generateArt(randseed, pattern_type, time_offset);
-    
-    // Clear screen
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    // Draw textured quad
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex2f(Width, 0.0f);
-    glTexCoord2f(1.0f, 1.0f); glVertex2f(Width, Height);
-    glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, Height);
-    glEnd();
+// Save the render settings and progress; written to a temporary file and renamed so a kill
+// mid-write leaves the previous state intact
+bool write_checkpoint_state(const char* dir, int total_frames, int framerate, int segment_frames,
+                            int completed_segments, int last_frame) {
+    char path[600], tmp_path[600];
+    snprintf(path, sizeof(path), "%s/state", dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/state.tmp", dir);
     
-    glutSwapBuffers();
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) return false;
+    fprintf(f, "width=%d\nheight=%d\nframerate=%d\ntotal_frames=%d\nsegment_frames=%d\n",
+            Width, Height, framerate, total_frames, segment_frames);
+    fprintf(f, "seed=%lu\npattern=%d\nrandom=%d\ncolor=%d\nprecision=%d\n",
+            randseed, pattern_type, random_mode, color_mode, precision_mode);
+    if (pattern_type == PATTERN_EXPR) {
+        fprintf(f, "expr=%s\n", pattern_expr_source);
+    }
+    if (color_mode == COLOR_MODE_PALETTE) {
+        fprintf(f, "palette=%s\n", palette_path);
+    }
+    fprintf(f, "completed_segments=%d\nlast_frame=%d\n", completed_segments, last_frame);
+    bool ok = fclose(f) == 0;
+    return ok && rename(tmp_path, path) == 0;
 }
 
-void cleanup() {
-    if (texture_data) {
-        free(texture_data);
-        texture_data = NULL;
-    }
+// Restore the render settings and progress from a checkpoint; false if there is none
+bool read_checkpoint_state(const char* dir, int* total_frames, int* framerate, int* segment_frames,
+                           int* completed_segments) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/state", dir);
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
     
-    // Free thread texture buffers
-    for (int i = 0; i < MAX_THREADS; i++) {
-        if (thread_texture_buffers[i]) {
-            free(thread_texture_buffers[i]);
-            thread_texture_buffers[i] = NULL;
+    int width = -1, height = -1, pattern = 0, random = 0, color = 0, precision = 0, fields = 0;
+    char line[EXPR_MAX_SOURCE + 16];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "expr=", 5) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            if (strlen(line + 5) > EXPR_MAX_SOURCE) {
+                fprintf(stderr, "Checkpoint state '%s' has an expression longer than %d characters\n",
+                        path, EXPR_MAX_SOURCE);
+                exit(1);
+            }
+            if (!compile_pattern_expr(line + 5, &pattern_program)) exit(1);
+            strcpy(pattern_expr_source, line + 5);
+            continue;
+        }
+        if (strncmp(line, "palette=", 8) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            if (!load_palette(line + 8)) exit(1);
+            continue;
         }
+        fields += sscanf(line, "width=%d", &width) + sscanf(line, "height=%d", &height) +
+                  sscanf(line, "framerate=%d", framerate) + sscanf(line, "total_frames=%d", total_frames) +
+                  sscanf(line, "segment_frames=%d", segment_frames) + sscanf(line, "seed=%lu", &randseed) +
+                  sscanf(line, "pattern=%d", &pattern) + sscanf(line, "random=%d", &random) +
+                  sscanf(line, "color=%d", &color) + sscanf(line, "precision=%d", &precision) +
+                  sscanf(line, "completed_segments=%d", completed_segments);
     }
+    fclose(f);
     
-    glDeleteTextures(1, &texture_id);
+    if (fields < 11) {
+        fprintf(stderr, "Checkpoint state '%s' is incomplete\n", path);
+        return false;
+    }
+    if (width != Width || height != Height) {
+        fprintf(stderr, "Checkpoint was rendered at %dx%d, not %dx%d\n", width, height, Width, Height);
+        exit(1);
+    }
+    pattern_type = (PatternType)pattern;
+    random_mode = (RandomnessMode)random;
+    color_mode = (ColorMode)color;
+    precision_mode = (PrecisionMode)precision;
+    return true;
 }
 
-void keyboard(unsigned char key, int x, int y) {
-    if (key == 27) { // ESC key
-        cleanup();
-        exit(0);
-    } else if (key == ' ') {
-        randseed = (unsigned long)time(NULL);
-    } else if (key >= '0' && key <= '9') {
-        // Map number keys to patterns
-        switch(key) {
-            case '0': pattern_type = ORIGINAL; break;
-            case '1': pattern_type = POLAR; break;
-            case '2': pattern_type = TRIGONOMETRIC; break;
-            case '3': pattern_type = FRACTAL; break;
-            case '4': pattern_type = WAVE_INTERFERENCE; break;
-            case '5': pattern_type = WAVE2; break;
-            case '6': pattern_type = VORTEX; break;
-            case '7': pattern_type = KALEIDOSCOPE; break;
-            case '8': pattern_type = PSYCHEDELIC; break;
-            case '9': pattern_type = CELLULAR; break;
-            default: return;
-        }
-        printf("Switched to pattern: %s\n", 
-            pattern_type == ORIGINAL ? "Original" :
-            pattern_type == POLAR ? "Polar" :
-            pattern_type == TRIGONOMETRIC ? "Trigonometric" :
-            pattern_type == FRACTAL ? "Fractal" :
-            pattern_type == WAVE_INTERFERENCE ? "Wave Interference" :
-            pattern_type == WAVE2 ? "Wave 2" :
-            pattern_type == VORTEX ? "Vortex" :
-            pattern_type == KALEIDOSCOPE ? "Kaleidoscope" :
-            pattern_type == PSYCHEDELIC ? "Psychedelic" :
-            pattern_type == CELLULAR ? "Cellular" : "Unknown");
-    } else if (key == 'c' || key == 'C') {
-        // Cycle through color modes
-        color_mode = (ColorMode)((color_mode + 1) % 3);  // Cycles through 3 modes
-        printf("Switched to %s mode\n", 
-            color_mode == COLOR_MODE_1 ? "original RGB" : 
-            color_mode == COLOR_MODE_2 ? "enhanced color" : 
-            "monochrome");
-    } else if (key == 'r' || key == 'R') {
-        // Cycle through random modes
-        random_mode = (RandomnessMode)((random_mode + 1) % 2);
-        printf("Switched to %s mode\n", 
-            random_mode == CLASSIC_RANDOM ? "classic random" : 
-            "enhanced random");
-    } else if (key == '+' || key == '=') {
-        // Increase number of threads
-        if (num_threads < MAX_THREADS) {
-            num_threads++;
-            printf("Increased to %d threads\n", num_threads);
-        } else {
-            printf("Already at maximum thread count: %d\n", MAX_THREADS);
-        }
-    } else if (key == '-' || key == '_') {
-        // Decrease number of threads
-        if (num_threads > 1) {
-            num_threads--;
-            printf("Decreased to %d threads\n", num_threads);
+// Encode the video as checkpointed segments, resuming after the last completed one when
+// asked, then stitch the segments into output_filename
+int render_video_checkpointed(const char* output_filename, int total_frames, int framerate) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s.checkpoint", output_filename);
+    
+    // Whole GOPs per segment, so every segment starts on its own keyframe
+    int segment_frames = (checkpoint_frames + VIDEO_GOP_SIZE - 1) / VIDEO_GOP_SIZE * VIDEO_GOP_SIZE;
+    int completed_segments = 0;
+    if (resume_render) {
+        if (read_checkpoint_state(dir, &total_frames, &framerate, &segment_frames, &completed_segments)) {
+            printf("Resuming %s at frame %d (pattern %s, seed %lu)\n", output_filename,
+                   completed_segments * segment_frames, pattern_type_name(pattern_type), randseed);
         } else {
-            printf("Already at minimum thread count: 1\n");
+            printf("No checkpoint found in %s; starting from the beginning\n", dir);
         }
-    } else if (key == 'h' || key == 'H') {
-        // Print pattern mapping help
-        printf("\nPattern Mapping:\n");
-        printf("0: Original\n");
-        printf("1: Polar\n");
-        printf("2: Trigonometric\n");
-        printf("3: Fractal\n");
-        printf("4: Wave Interference\n");
-        printf("5: Wave 2\n");
-        printf("6: Vortex\n");
-        printf("7: Kaleidoscope\n");
-        printf("8: Psychedelic\n");
-        printf("9: Cellular\n");
-    } else {
-        // Generate new art with current pattern type but different seed
-        randseed = randseed | (key * 10);
     }
-}
-
-void idle(void) {
-    display();
-}
-
-// Function to get current time in seconds
-double get_current_time() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
-
-// Function to print progress
-void print_progress(int current_frame, int total_frames, double start_time) {
-    double current_time = get_current_time();
-    double elapsed = current_time - start_time;
-    double progress = (double)current_frame / total_frames;
-    double estimated_total = elapsed / progress;
-    double remaining = estimated_total - elapsed;
-    
-    printf("\rProgress: %d/%d frames (%.1f%%) - Elapsed: %.1fs - Remaining: %.1fs", 
-           current_frame, total_frames, progress * 100, 
-           elapsed, remaining);
-    fflush(stdout);
-}
-
-// Initialize video encoding context
-VideoContext* init_video_encoder(const char* filename, int width, int height, int framerate) {
-    VideoContext* ctx = (VideoContext*)calloc(1, sizeof(VideoContext));
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create checkpoint directory '%s': %s\n", dir, strerror(errno));
+        return 1;
+    }
     
-    // Allocate format context
-    avformat_alloc_output_context2(&ctx->format_context, NULL, NULL, filename);
-    if (!ctx->format_context) {
-        fprintf(stderr, "Could not create output context\n");
-        return NULL;
+    int segment_count = (total_frames + segment_frames - 1) / segment_frames;
+    char** segment_files = (char**)malloc(segment_count * sizeof(char*));
+    int* first_frames = (int*)malloc(segment_count * sizeof(int));
+    for (int k = 0; k < segment_count; k++) {
+        segment_files[k] = (char*)malloc(600);
+        snprintf(segment_files[k], 600, "%s/seg%05d.mp4", dir, k);
+        first_frames[k] = k * segment_frames;
     }
     
-    // Find the h264 encoder
-    const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
-    if (!codec) {
-        fprintf(stderr, "Codec not found\n");
-        return NULL;
+    int result = 0;
+    double start_time = get_current_time();
+    int start_segment = completed_segments;
+    for (int k = completed_segments; k < segment_count; k++) {
+        int frame_count = total_frames - first_frames[k] < segment_frames ? total_frames - first_frames[k] : segment_frames;
+        if (!encode_video_segment(segment_files[k], first_frames[k], frame_count, framerate) ||
+            !write_checkpoint_state(dir, total_frames, framerate, segment_frames, k + 1,
+                                    first_frames[k] + frame_count - 1)) {
+            fprintf(stderr, "\nCheckpoint segment %d failed\n", k);
+            result = 1;
+            break;
+        }
+        
+        // Progress over the segments rendered by this run
+        double elapsed = get_current_time() - start_time;
+        double remaining = elapsed / (k + 1 - start_segment) * (segment_count - k - 1);
+        printf("\rCheckpoint %d/%d: frames %d/%d - Elapsed: %.1fs - Remaining: %.1fs",
+               k + 1, segment_count, first_frames[k] + frame_count, total_frames, elapsed, remaining);
+        fflush(stdout);
     }
     
-    // Create new video stream
-    ctx->video_stream = avformat_new_stream(ctx->format_context, codec);
-    if (!ctx->video_stream) {
-        fprintf(stderr, "Could not allocate stream\n");
-        return NULL;
+    if (result == 0) {
+        printf("\nStitching %d segments...\n", segment_count);
+        result = remux_segments(segment_files, first_frames, segment_count, output_filename, framerate) == 0 ? 0 : 1;
+    }
+    if (result == 0) {
+        char path[600];
+        for (int k = 0; k < segment_count; k++) {
+            remove(segment_files[k]);
+        }
+        snprintf(path, sizeof(path), "%s/state", dir);
+        remove(path);
+        rmdir(dir);
     }
     
-    // Allocate codec context
-    ctx->codec_context = avcodec_alloc_context3(codec);
-    if (!ctx->codec_context) {
-        fprintf(stderr, "Could not allocate video codec context\n");
-        return NULL;
+    for (int k = 0; k < segment_count; k++) {
+        free(segment_files[k]);
     }
+    free(segment_files);
+    free(first_frames);
+    return result;
+}
+
+// Fill a socket address from "unix:/path", "tcp:host:port" or "host:port"
+bool farm_parse_address(const char* address, struct sockaddr_storage* addr, socklen_t* addr_len) {
+    memset(addr, 0, sizeof(*addr));
     
-    // Set codec parameters
-    ctx->codec_context->bit_rate = 2000000;  // Reduced to 2Mbps for reasonable file size
-    ctx->codec_context->width = width;
-    ctx->codec_context->height = height;
-    ctx->codec_context->time_base = (AVRational){1, framerate};
-    ctx->codec_context->framerate = (AVRational){framerate, 1};
-    ctx->codec_context->gop_size = 30;  // Increased GOP size for better compression
-    ctx->codec_context->max_b_frames = 2;  // Increased B-frames
-    ctx->codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un* un = (struct sockaddr_un*)addr;
+        if (strlen(address + 5) >= sizeof(un->sun_path)) return false;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address + 5);
+        *addr_len = sizeof(*un);
+        return true;
+    }
     
-    // Set x264 specific encoding parameters for high quality
-    AVDictionary *param = NULL;
-    av_dict_set(&param, "preset", "faster", 0);  // Faster encoding, artificial content doesn't benefit much from slow
-    av_dict_set(&param, "tune", "animation", 0);  // Optimize for animation content
-    av_dict_set(&param, "crf", "28", 0);  // Changed to 28 for good quality with much smaller file size
+    if (strncmp(address, "tcp:", 4) == 0) address += 4;
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (!colon || colon == address || (size_t)(colon - address) >= sizeof(host)) return false;
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
     
-    // Set stream parameters
-    avcodec_parameters_from_context(ctx->video_stream->codecpar, ctx->codec_context);
+    struct addrinfo hints, *info = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, colon + 1, &hints, &info) != 0 || !info) return false;
+    memcpy(addr, info->ai_addr, info->ai_addrlen);
+    *addr_len = info->ai_addrlen;
+    freeaddrinfo(info);
+    return true;
+}
+
+int farm_listen(const char* address) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (!farm_parse_address(address, &addr, &addr_len)) {
+        fprintf(stderr, "Invalid farm address '%s'\n", address);
+        return -1;
+    }
     
-    // Open codec with quality parameters
-    if (avcodec_open2(ctx->codec_context, codec, &param) < 0) {
-        fprintf(stderr, "Could not open codec\n");
-        return NULL;
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (addr.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un*)&addr)->sun_path);
+    } else {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+    if (bind(fd, (struct sockaddr*)&addr, addr_len) < 0 || listen(fd, FARM_MAX_CONNECTIONS) < 0) {
+        fprintf(stderr, "Could not listen on '%s': %s\n", address, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Connect to the coordinator, retrying for a few seconds in case it is still starting
+int farm_connect(const char* address) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (!farm_parse_address(address, &addr, &addr_len)) {
+        fprintf(stderr, "Invalid farm address '%s'\n", address);
+        return -1;
     }
-    av_dict_free(&param);
     
-    // Open output file
-    if (avio_open(&ctx->format_context->pb, filename, AVIO_FLAG_WRITE) < 0) {
-        fprintf(stderr, "Could not open output file '%s'\n", filename);
-        return NULL;
+    for (int attempt = 0; attempt < 50; attempt++) {
+        int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&addr, addr_len) == 0) return fd;
+        close(fd);
+        usleep(100000);
+    }
+    fprintf(stderr, "Could not connect to '%s': %s\n", address, strerror(errno));
+    return -1;
+}
+
+bool farm_send_all(int fd, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        ssize_t sent = send(fd, p, len, 0);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        p += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+// Read one newline-terminated control line (blocking); false on disconnect
+bool farm_read_line(int fd, char* line, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        char c;
+        ssize_t got = recv(fd, &c, 1, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        if (c == '\n') break;
+        line[len++] = c;
     }
+    line[len] = '\0';
+    return true;
+}
+
+// Worker mode: take frame ranges from the coordinator, encode each into a segment and send
+// the encoded bytes back, until told the job is done
+int run_farm_worker(const char* address) {
+    signal(SIGPIPE, SIG_IGN);
+    int fd = farm_connect(address);
+    if (fd < 0) return 1;
+    printf("Worker %d connected to %s\n", (int)getpid(), address);
     
-    // Write format header
-    if (avformat_write_header(ctx->format_context, NULL) < 0) {
-        fprintf(stderr, "Error occurred when writing header\n");
-        return NULL;
+    const char* tmp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char line[EXPR_MAX_SOURCE + PALETTE_MESSAGE_SIZE + 64];
+    bool ok = farm_send_all(fd, "READY\n", 6);
+    while (ok && farm_read_line(fd, line, sizeof(line))) {
+        if (strcmp(line, "DONE") == 0) break;
+        if (strncmp(line, "EXPR ", 5) == 0) {
+            if (strlen(line + 5) > EXPR_MAX_SOURCE) {
+                fprintf(stderr, "Worker got an expression longer than %d characters\n", EXPR_MAX_SOURCE);
+                break;
+            }
+            if (!compile_pattern_expr(line + 5, &pattern_program)) break;
+            strcpy(pattern_expr_source, line + 5);
+            continue;
+        }
+        if (strncmp(line, "PALETTE ", 8) == 0) {
+            if (!palette_from_hex(line + 8)) break;
+            continue;
+        }
+        
+        int job_id, first_frame, frame_count, width, height, framerate, pattern, random, color, precision;
+        unsigned long seed;
+        if (sscanf(line, "JOB %d %d %d %d %d %d %lu %d %d %d %d", &job_id, &first_frame, &frame_count,
+                   &width, &height, &framerate, &seed, &pattern, &random, &color, &precision) != 11) {
+            fprintf(stderr, "Worker got unexpected message '%s'\n", line);
+            break;
+        }
+        
+        // Adopt the coordinator's settings for this range
+        if (width != Width || height != Height) {
+            Width = width;
+            Height = height;
+            release_frame_buffers();
+            init_frame_buffers(Width, Height);
+        }
+        randseed = seed;
+        pattern_type = (PatternType)pattern;
+        random_mode = (RandomnessMode)random;
+        color_mode = (ColorMode)color;
+        precision_mode = (PrecisionMode)precision;
+        
+        char segment_path[512];
+        snprintf(segment_path, sizeof(segment_path), "%s/artmaker_segment_%d_%d.mp4",
+                 tmp_dir, (int)getpid(), job_id);
+        printf("Worker %d: frames %d-%d\n", (int)getpid(), first_frame, first_frame + frame_count - 1);
+        
+        char header[128];
+        struct stat st;
+        FILE* segment = NULL;
+        if (encode_video_segment(segment_path, first_frame, frame_count, framerate) &&
+            stat(segment_path, &st) == 0 && (segment = fopen(segment_path, "rb"))) {
+            snprintf(header, sizeof(header), "SEGMENT %d %lld\n", job_id, (long long)st.st_size);
+            ok = farm_send_all(fd, header, strlen(header));
+            
+            uint8_t chunk[65536];
+            size_t got;
+            while (ok && (got = fread(chunk, 1, sizeof(chunk), segment)) > 0) {
+                ok = farm_send_all(fd, chunk, got);
+            }
+            fclose(segment);
+        } else {
+            snprintf(header, sizeof(header), "FAILED %d\n", job_id);
+            ok = farm_send_all(fd, header, strlen(header));
+        }
+        remove(segment_path);
+        
+        ok = ok && farm_send_all(fd, "READY\n", 6);
     }
     
-    // Allocate frame
-    ctx->frame = av_frame_alloc();
-    ctx->frame->format = ctx->codec_context->pix_fmt;
-    ctx->frame->width = width;
-    ctx->frame->height = height;
-    
-    if (av_frame_get_buffer(ctx->frame, 0) < 0) {
-        fprintf(stderr, "Could not allocate frame data\n");
-        return NULL;
+    close(fd);
+    return ok ? 0 : 1;
+}
+
+// Return a worker's unfinished range to the queue and close its connection
+void farm_drop_connection(FarmConnection* conn, FarmJob* jobs) {
+    if (conn->segment) {
+        fclose(conn->segment);
+        conn->segment = NULL;
     }
-    
-    // Initialize frame buffer for RGB data
-    ctx->frame_buffer = (uint8_t*)malloc(width * height * 3);
-    
-    // Initialize scaling context
-    ctx->sws_context = sws_getContext(width, height, AV_PIX_FMT_RGB24,
-                                    width, height, AV_PIX_FMT_YUV420P,
-                                    SWS_BILINEAR,  // Simple bilinear filtering is sufficient for 1:1 color conversion
-                                    NULL, NULL, NULL);
-    
-    if (!ctx->sws_context) {
-        fprintf(stderr, "Could not initialize scaling context\n");
-        return NULL;
+    if (conn->job >= 0 && jobs[conn->job].state != FARM_JOB_DONE) {
+        FarmJob* job = &jobs[conn->job];
+        remove(job->segment_path);
+        job->state = FARM_JOB_PENDING;
+        printf("\nWorker lost; re-queueing frames %d-%d\n",
+               job->first_frame, job->first_frame + job->frame_count - 1);
     }
-    
-    return ctx;
+    close(conn->fd);
+    conn->fd = -1;
+    conn->job = -1;
 }
 
-// Encode a frame
-int encode_frame(VideoContext* ctx, const uint8_t* rgb_data) {
-    // Convert RGB to YUV
-    const uint8_t* rgb_data_ptr[1] = { rgb_data };
-    int rgb_linesize[1] = { ctx->codec_context->width * 3 };
-    sws_scale(ctx->sws_context, rgb_data_ptr, rgb_linesize, 0, ctx->codec_context->height,
-              ctx->frame->data, ctx->frame->linesize);
+// Handle bytes from a worker: control lines, or the payload of a segment being received.
+// Returns false if the connection should be dropped.
+bool farm_handle_input(FarmConnection* conn, FarmJob* jobs, int job_count,
+                       const uint8_t* data, size_t len, int* done_count) {
+    while (len > 0) {
+        if (conn->segment) {
+            size_t n = len < conn->segment_left ? len : conn->segment_left;
+            if (fwrite(data, 1, n, conn->segment) != n) return false;
+            data += n;
+            len -= n;
+            conn->segment_left -= n;
+        } else {
+            char c = (char)*data++;
+            len--;
+            if (c != '\n') {
+                if (conn->input_len + 1 >= (int)sizeof(conn->input)) return false;
+                conn->input[conn->input_len++] = c;
+                continue;
+            }
+            conn->input[conn->input_len] = '\0';
+            conn->input_len = 0;
+            
+            int job_id;
+            long long bytes;
+            if (strcmp(conn->input, "READY") == 0) {
+                conn->ready = true;
+            } else if (sscanf(conn->input, "SEGMENT %d %lld", &job_id, &bytes) == 2) {
+                if (job_id != conn->job || bytes < 0) return false;
+                conn->segment = fopen(jobs[job_id].segment_path, "wb");
+                if (!conn->segment) {
+                    fprintf(stderr, "\nCould not write segment '%s'\n", jobs[job_id].segment_path);
+                    return false;
+                }
+                conn->segment_left = (size_t)bytes;
+            } else if (sscanf(conn->input, "FAILED %d", &job_id) == 1) {
+                return false;  // Dropping the connection re-queues the range
+            } else {
+                return false;
+            }
+        }
+        
+        // A fully received segment completes its range
+        if (conn->segment && conn->segment_left == 0) {
+            fclose(conn->segment);
+            conn->segment = NULL;
+            jobs[conn->job].state = FARM_JOB_DONE;
+            conn->job = -1;
+            (*done_count)++;
+            printf("\rFarm: %d/%d segments complete", *done_count, job_count);
+            fflush(stdout);
+        }
+    }
+    return true;
+}
+
+// Spawn a local worker process connected to this coordinator
+pid_t farm_spawn_worker(const char* program, const char* address) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        char width[16], height[16], tiles[16], threads[16];
+        snprintf(width, sizeof(width), "%d", Width);
+        snprintf(height, sizeof(height), "%d", Height);
+        snprintf(tiles, sizeof(tiles), "%d", tilesize);
+        snprintf(threads, sizeof(threads), "%d", num_threads);
+        execlp(program, program, width, height, tiles, "--worker", address, "-t", threads, (char*)NULL);
+        fprintf(stderr, "Could not start worker '%s': %s\n", program, strerror(errno));
+        _exit(1);
+    }
+    return pid;
+}
+
+// Coordinator mode: split the video into ranges of farm_chunk_frames, dispatch them to
+// workers as they report READY, and remux the returned segments into output_filename
+int run_farm_coordinator(const char* address, const char* output_filename, int total_frames,
+                         int framerate, const char* program) {
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = farm_listen(address);
+    if (listen_fd < 0) return 1;
     
-    ctx->frame->pts = ctx->frame_count;
+    int job_count = (total_frames + farm_chunk_frames - 1) / farm_chunk_frames;
+    FarmJob* jobs = (FarmJob*)calloc(job_count, sizeof(FarmJob));
+    for (int k = 0; k < job_count; k++) {
+        jobs[k].first_frame = k * farm_chunk_frames;
+        jobs[k].frame_count = total_frames - jobs[k].first_frame < farm_chunk_frames ?
+                              total_frames - jobs[k].first_frame : farm_chunk_frames;
+        jobs[k].state = FARM_JOB_PENDING;
+        snprintf(jobs[k].segment_path, sizeof(jobs[k].segment_path), "%s.seg%04d.mp4", output_filename, k);
+    }
     
-    // Send frame to encoder
-    int ret = avcodec_send_frame(ctx->codec_context, ctx->frame);
-    if (ret < 0) {
-        fprintf(stderr, "Error sending frame for encoding\n");
-        return -1;
+    pid_t children[FARM_MAX_CONNECTIONS];
+    int child_count = 0;
+    for (int w = 0; w < farm_local_workers && w < FARM_MAX_CONNECTIONS; w++) {
+        pid_t pid = farm_spawn_worker(program, address);
+        if (pid > 0) children[child_count++] = pid;
     }
+    printf("Farm: %d frames in %d ranges of up to %d frames on %s (%d local worker%s)\n",
+           total_frames, job_count, farm_chunk_frames, address, child_count, child_count == 1 ? "" : "s");
     
-    while (ret >= 0) {
-        AVPacket *pkt = av_packet_alloc();
-        ret = avcodec_receive_packet(ctx->codec_context, pkt);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            av_packet_free(&pkt);
+    FarmConnection conns[FARM_MAX_CONNECTIONS];
+    for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+        conns[c].fd = -1;
+        conns[c].job = -1;
+        conns[c].segment = NULL;
+    }
+    
+    int done_count = 0;
+    bool failed = false;
+    double start_time = get_current_time();
+    while (done_count < job_count && !failed) {
+        // Hand pending ranges to idle workers
+        for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+            FarmConnection* conn = &conns[c];
+            if (conn->fd < 0 || !conn->ready || conn->job >= 0) continue;
+            
+            int k = 0;
+            while (k < job_count && jobs[k].state != FARM_JOB_PENDING) k++;
+            if (k == job_count) break;
+            if (jobs[k].attempts >= FARM_MAX_ATTEMPTS) {
+                fprintf(stderr, "\nFrames %d-%d failed %d times; giving up\n",
+                        jobs[k].first_frame, jobs[k].first_frame + jobs[k].frame_count - 1, jobs[k].attempts);
+                failed = true;
+                break;
+            }
+            
+            // Workers compile the expression and install the palette before the job that uses them.
+            // The palette goes by value, since workers need not share the coordinator's files.
+            char message[EXPR_MAX_SOURCE + PALETTE_MESSAGE_SIZE + 256];
+            int expr_len = 0;
+            if (pattern_type == PATTERN_EXPR) {
+                expr_len = snprintf(message, sizeof(message), "EXPR %s\n", pattern_expr_source);
+            }
+            if (color_mode == COLOR_MODE_PALETTE) {
+                expr_len += snprintf(message + expr_len, sizeof(message) - expr_len, "PALETTE ");
+                palette_to_hex(message + expr_len);
+                expr_len += strlen(message + expr_len);
+                expr_len += snprintf(message + expr_len, sizeof(message) - expr_len, "\n");
+            }
+            snprintf(message + expr_len, sizeof(message) - expr_len, "JOB %d %d %d %d %d %d %lu %d %d %d %d\n",
+                     k, jobs[k].first_frame, jobs[k].frame_count, Width, Height, framerate, randseed,
+                     pattern_type, random_mode, color_mode, precision_mode);
+            if (!farm_send_all(conn->fd, message, strlen(message))) {
+                farm_drop_connection(conn, jobs);
+                continue;
+            }
+            jobs[k].state = FARM_JOB_ASSIGNED;
+            jobs[k].attempts++;
+            conn->job = k;
+            conn->ready = false;
+            conn->assigned_time = get_current_time();
+        }
+        
+        struct pollfd fds[FARM_MAX_CONNECTIONS + 1];
+        int conn_index[FARM_MAX_CONNECTIONS + 1];
+        int nfds = 0;
+        fds[nfds].fd = listen_fd;
+        fds[nfds].events = POLLIN;
+        conn_index[nfds++] = -1;
+        for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+            if (conns[c].fd < 0) continue;
+            fds[nfds].fd = conns[c].fd;
+            fds[nfds].events = POLLIN;
+            conn_index[nfds++] = c;
+        }
+        
+        if (poll(fds, nfds, 1000) < 0 && errno != EINTR) {
+            fprintf(stderr, "\npoll failed: %s\n", strerror(errno));
+            failed = true;
             break;
-        } else if (ret < 0) {
-            fprintf(stderr, "Error during encoding\n");
-            av_packet_free(&pkt);
-            return -1;
         }
         
-        pkt->stream_index = ctx->video_stream->index;
-        av_packet_rescale_ts(pkt, ctx->codec_context->time_base, ctx->video_stream->time_base);
-        ret = av_interleaved_write_frame(ctx->format_context, pkt);
-        av_packet_free(&pkt);
-        if (ret < 0) {
-            fprintf(stderr, "Error writing packet\n");
-            return -1;
+        for (int f = 0; f < nfds; f++) {
+            if (!(fds[f].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            
+            if (conn_index[f] < 0) {
+                int fd = accept(listen_fd, NULL, NULL);
+                if (fd < 0) continue;
+                int c = 0;
+                while (c < FARM_MAX_CONNECTIONS && conns[c].fd >= 0) c++;
+                if (c == FARM_MAX_CONNECTIONS) {
+                    close(fd);
+                    continue;
+                }
+                conns[c].fd = fd;
+                conns[c].job = -1;
+                conns[c].ready = false;
+                conns[c].input_len = 0;
+                conns[c].segment = NULL;
+                continue;
+            }
+            
+            FarmConnection* conn = &conns[conn_index[f]];
+            uint8_t buffer[65536];
+            ssize_t got = recv(conn->fd, buffer, sizeof(buffer), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0 || !farm_handle_input(conn, jobs, job_count, buffer, (size_t)got, &done_count)) {
+                farm_drop_connection(conn, jobs);
+            }
+        }
+        
+        // Re-queue ranges whose worker has gone quiet for too long
+        double now = get_current_time();
+        for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+            if (conns[c].fd >= 0 && conns[c].job >= 0 && now - conns[c].assigned_time > FARM_JOB_TIMEOUT) {
+                farm_drop_connection(&conns[c], jobs);
+            }
+        }
+        
+        // With only local workers, stop once they have all exited
+        if (child_count > 0) {
+            int alive = 0;
+            for (int w = 0; w < child_count; w++) {
+                if (children[w] > 0 && waitpid(children[w], NULL, WNOHANG) == children[w]) children[w] = -1;
+                if (children[w] > 0) alive++;
+            }
+            int connected = 0;
+            for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+                if (conns[c].fd >= 0) connected++;
+            }
+            if (alive == 0 && connected == 0) {
+                fprintf(stderr, "\nAll local workers exited with work remaining\n");
+                failed = true;
+            }
         }
     }
     
-    return 0;
-}
-
-// Finalize video encoding
-void finalize_video_encoder(VideoContext* ctx) {
-    // Flush encoder
-    encode_frame(ctx, NULL);
-    
-    // Write trailer
-    av_write_trailer(ctx->format_context);
-    
-    // Close file
-    avio_closep(&ctx->format_context->pb);
+    // Release the workers
+    for (int c = 0; c < FARM_MAX_CONNECTIONS; c++) {
+        if (conns[c].fd < 0) continue;
+        farm_send_all(conns[c].fd, "DONE\n", 5);
+        farm_drop_connection(&conns[c], jobs);
+    }
+    close(listen_fd);
+    if (strncmp(address, "unix:", 5) == 0) unlink(address + 5);
+    for (int w = 0; w < child_count; w++) {
+        if (children[w] > 0) waitpid(children[w], NULL, 0);
+    }
     
-    // Free resources
-    avcodec_free_context(&ctx->codec_context);
-    av_frame_free(&ctx->frame);
-    avformat_free_context(ctx->format_context);
-    sws_freeContext(ctx->sws_context);
-    free(ctx->frame_buffer);
-    free(ctx);
-}
-
-// Function to read framebuffer
-void read_pixels_to_buffer(uint8_t* buffer, int width, int height) {
-    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, buffer);
+    int result = 1;
+    if (!failed) {
+        printf("\nFarm: rendered in %.1fs, remuxing %d segments\n", get_current_time() - start_time, job_count);
+        char** segment_files = (char**)malloc(job_count * sizeof(char*));
+        int* first_frames = (int*)malloc(job_count * sizeof(int));
+        for (int k = 0; k < job_count; k++) {
+            segment_files[k] = jobs[k].segment_path;
+            first_frames[k] = jobs[k].first_frame;
+        }
+        result = remux_segments(segment_files, first_frames, job_count, output_filename, framerate) == 0 ? 0 : 1;
+        free(segment_files);
+        free(first_frames);
+    }
+    for (int k = 0; k < job_count; k++) {
+        remove(jobs[k].segment_path);
+    }
+    free(jobs);
+    return result;
 }
 
 int main(int argc, char *argv[]) {
+    process_start_time = get_current_time();
     if(argc < 4) {
         print_usage(argv[0]);
         exit(1);
@@ -893,6 +4770,37 @@ int main(int argc, char *argv[]) {
                 printf("Missing pattern type after -p option.\n");
                 exit(1);
             }
+        } else if (strcmp(argv[i], "--pattern-expr") == 0) {
+            if (i + 1 < argc) {
+                if (strlen(argv[i + 1]) > EXPR_MAX_SOURCE) {
+                    printf("Pattern expression is longer than %d characters.\n", EXPR_MAX_SOURCE);
+                    exit(1);
+                }
+                if (!compile_pattern_expr(argv[i + 1], &pattern_program)) {
+                    exit(1);
+                }
+                strcpy(pattern_expr_source, argv[i + 1]);
+                pattern_type = PATTERN_EXPR;
+                i++;
+            } else {
+                printf("Missing expression after --pattern-expr option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--palette") == 0) {
+            if (i + 1 < argc) {
+                if (strlen(argv[i + 1]) > PALETTE_MAX_PATH) {
+                    printf("Palette path is longer than %d characters.\n", PALETTE_MAX_PATH);
+                    exit(1);
+                }
+                if (!load_palette(argv[i + 1])) {
+                    exit(1);
+                }
+                color_mode = COLOR_MODE_PALETTE;
+                i++;
+            } else {
+                printf("Missing file after --palette option.\n");
+                exit(1);
+            }
         } else if (strcmp(argv[i], "--fill-rects") == 0) {
             fill_rects = true;
         } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) {
@@ -916,6 +4824,12 @@ int main(int argc, char *argv[]) {
                 output_config.duration_seconds = atoi(argv[i + 1]);
                 output_config.framerate = atoi(argv[i + 2]);
                 i += 2;
+                
+                // Optional rendition list, e.g. 2160,1080,720,360
+                if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+                    output_config.rendition_count = parse_rendition_list(argv[i + 1], output_config.rendition_heights);
+                    i++;
+                }
             } else {
                 printf("Missing duration and/or framerate after -out-mode option.\n");
                 exit(1);
@@ -944,6 +4858,146 @@ int main(int argc, char *argv[]) {
                 printf("Missing color mode after -c option.\n");
                 exit(1);
             }
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            if (i + 1 < argc) {
+                pin_workers = true;
+                if (strcmp(argv[i + 1], "auto") != 0) {
+                    pin_cpu_count = parse_cpu_list(argv[i + 1], pin_cpu_list, MAX_CPUS);
+                    if (pin_cpu_count == 0) {
+                        printf("Invalid CPU list '%s'.\n", argv[i + 1]);
+                        exit(1);
+                    }
+                }
+                i++;
+            } else {
+                printf("Missing CPU list after --pin option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--precision") == 0) {
+            if (i + 1 < argc) {
+                precision_mode = parse_precision_mode(argv[i + 1]);
+                i++;
+            } else {
+                printf("Missing precision tier after --precision option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--precision-report") == 0) {
+            precision_report = true;
+        } else if (strcmp(argv[i], "--timings") == 0) {
+            show_timings = true;
+        } else if (strcmp(argv[i], "--traversal") == 0) {
+            if (i + 1 < argc) {
+                traversal_mode = parse_traversal_mode(argv[i + 1]);
+                i++;
+            } else {
+                printf("Missing order after --traversal option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            if (i + 1 < argc) {
+                if (strcmp(argv[i + 1], "off") == 0) huge_page_mode = HUGE_PAGES_OFF;
+                else if (strcmp(argv[i + 1], "auto") == 0) huge_page_mode = HUGE_PAGES_AUTO;
+                else if (strcmp(argv[i + 1], "explicit") == 0) huge_page_mode = HUGE_PAGES_EXPLICIT;
+                else printf("Invalid huge page mode '%s'. Using default (auto).\n", argv[i + 1]);
+                i++;
+            } else {
+                printf("Missing mode after --huge-pages option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--cpu-budget") == 0) {
+            if (i + 1 < argc) {
+                cpu_budget = atoi(argv[i + 1]);
+                if (cpu_budget < 2) {
+                    printf("CPU budget must be at least 2 cores. Ignoring it.\n");
+                    cpu_budget = 0;
+                }
+                i++;
+            } else {
+                printf("Missing core count after --cpu-budget option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0) {
+            if (i + 1 < argc) {
+                checkpoint_frames = atoi(argv[i + 1]);
+                if (checkpoint_frames < 1) checkpoint_frames = VIDEO_GOP_SIZE;
+                i++;
+            } else {
+                printf("Missing frame count after --checkpoint option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume_render = true;
+        } else if (strcmp(argv[i], "--coordinator") == 0) {
+            if (i + 1 < argc) {
+                farm_coordinator_address = argv[i + 1];
+                i++;
+            } else {
+                printf("Missing address after --coordinator option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--farm-workers") == 0) {
+            if (i + 1 < argc) {
+                farm_local_workers = atoi(argv[i + 1]);
+                if (farm_local_workers < 0) farm_local_workers = 0;
+                i++;
+            } else {
+                printf("Missing worker count after --farm-workers option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--chunk") == 0) {
+            if (i + 1 < argc) {
+                farm_chunk_frames = atoi(argv[i + 1]);
+                if (farm_chunk_frames < 1) farm_chunk_frames = FARM_DEFAULT_CHUNK;
+                i++;
+            } else {
+                printf("Missing frame count after --chunk option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--worker") == 0) {
+            if (i + 1 < argc) {
+                farm_worker_address = argv[i + 1];
+                i++;
+            } else {
+                printf("Missing address after --worker option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            use_counters = true;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i + 1 < argc) {
+                trace_filename = argv[i + 1];
+                i++;
+            } else {
+                printf("Missing filename after --trace option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--explore") == 0) {
+            if (i + 1 < argc) {
+                explore_seeds = atoi(argv[i + 1]);
+                if (explore_seeds < 1) explore_seeds = 1;
+                i++;
+            } else {
+                printf("Missing seed count after --explore option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--top") == 0) {
+            if (i + 1 < argc) {
+                explore_top = atoi(argv[i + 1]);
+                if (explore_top < 1) explore_top = 1;
+                i++;
+            } else {
+                printf("Missing count after --top option.\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 < argc) {
+                bench_frames = atoi(argv[i + 1]);
+                if (bench_frames < 1) bench_frames = 1;
+                i++;
+            } else {
+                printf("Missing frame count after --bench option.\n");
+                exit(1);
+            }
         } else {
             printf("Unknown option '%s'\n", argv[i]);
             exit(1);
@@ -955,47 +5009,78 @@ int main(int argc, char *argv[]) {
 
     randseed = (unsigned long)time(NULL);
     
-    // Initialize OpenGL
-    initGL(Width, Height, argc, argv);
+    if (trace_filename) {
+#ifdef ARTMAKER_TRACE
+        trace_start();
+#else
+        printf("Tracing is not compiled in; rebuild with 'make TRACE=1' to use --trace.\n");
+        trace_filename = NULL;
+#endif
+    }
+    
+    timing_mark("options parsed");
+    if (cpu_budget > 0) {
+        apply_cpu_budget();
+    }
+    
+    detect_cpu_topology();
+#ifndef __linux__
+    if (pin_workers) {
+        printf("CPU pinning is not supported on this platform; workers are left to the scheduler\n");
+        pin_workers = false;
+    }
+#endif
+    assign_worker_cpus();
+    print_worker_placement();
+    timing_mark("CPU topology");
+    
+    // One frame now; band buffers are allocated by each render thread on first use, so only
+    // the -t threads that run get one
+    init_frame_buffers(Width, Height);
+    timing_mark("frame buffers");
+    
+    if (farm_worker_address) {
+        int result = run_farm_worker(farm_worker_address);
+        cleanup();
+        exit(result);
+    }
+    if (farm_coordinator_address && output_config.mode != VIDEO_MODE) {
+        printf("--coordinator needs -out-mode <sec> <fps>.\n");
+        exit(1);
+    }
+    if (use_counters && bench_frames == 0) {
+        printf("--counters needs --bench <frames>.\n");
+        exit(1);
+    }
+    
+    if (explore_seeds > 0) {
+        char sheet_buffer[256];
+        const char* sheet_filename = output_config.output_filename;
+        if (!sheet_filename) {
+            snprintf(sheet_buffer, sizeof(sheet_buffer), "explore_%s_%s_%lu.ppm",
+                     pattern_type_name(pattern_type), color_mode_name(color_mode), randseed);
+            sheet_filename = sheet_buffer;
+        }
+        int result = run_explore(sheet_filename);
+        cleanup();
+        exit(result);
+    }
+    
+    if (bench_frames > 0 || precision_report) {
+        if (precision_report) run_precision_report();
+        if (bench_frames > 0) run_benchmark();
+        cleanup();
+        exit(0);
+    }
     
     if (output_config.mode == VIDEO_MODE) {
         // Generate output filename if not specified
         char filename_buffer[256];
         if (!output_config.output_filename) {
-            const char* pattern_name;
-            switch(pattern_type) {
-                case ORIGINAL: pattern_name = "original"; break;
-                case POLAR: pattern_name = "polar"; break;
-                case TRIGONOMETRIC: pattern_name = "trig"; break;
-                case FRACTAL: pattern_name = "fractal"; break;
-                case WAVE_INTERFERENCE: pattern_name = "wave"; break;
-                case WAVE2: pattern_name = "wave2"; break;
-                case VORTEX: pattern_name = "vortex"; break;
-                case KALEIDOSCOPE: pattern_name = "kaleidoscope"; break;
-                case PSYCHEDELIC: pattern_name = "psychedelic"; break;
-                case CELLULAR: pattern_name = "cellular"; break;
-                default: pattern_name = "unknown"; break;
-            }
-            
-            const char* random_name;
-            switch(random_mode) {
-                case CLASSIC_RANDOM: random_name = "classic"; break;
-                case ENHANCED_RANDOM: random_name = "enhanced"; break;
-                default: random_name = "unknown"; break;
-            }
-            
-            const char* color_name;
-            switch(color_mode) {
-                case COLOR_MODE_1: color_name = "rgb"; break;
-                case COLOR_MODE_2: color_name = "enhanced"; break;
-                case COLOR_MODE_MONO: color_name = "mono"; break;
-                default: color_name = "unknown"; break;
-            }
-            
             snprintf(filename_buffer, sizeof(filename_buffer), 
                     "art_%dx%d_%s_%s_%s_%ds.mp4", 
-                    Width, Height, pattern_name, random_name, color_name,
-                    output_config.duration_seconds);
+                    Width, Height, pattern_type_name(pattern_type), random_mode_name(random_mode),
+                    color_mode_name(color_mode), output_config.duration_seconds);
             output_config.output_filename = filename_buffer;
         }
         
@@ -1003,80 +5088,75 @@ int main(int argc, char *argv[]) {
         printf("Duration: %d seconds at %d fps\n", 
                output_config.duration_seconds, output_config.framerate);
         printf("Pattern: %s, Random: %s, Color: %s\n",
-               pattern_type == ORIGINAL ? "original" :
-               pattern_type == POLAR ? "polar" :
-               pattern_type == TRIGONOMETRIC ? "trig" :
-               pattern_type == FRACTAL ? "fractal" :
-               pattern_type == WAVE_INTERFERENCE ? "wave" :
-               pattern_type == WAVE2 ? "wave2" :
-               pattern_type == VORTEX ? "vortex" :
-               pattern_type == KALEIDOSCOPE ? "kaleidoscope" :
-               pattern_type == PSYCHEDELIC ? "psychedelic" :
-               pattern_type == CELLULAR ? "cellular" : "unknown",
-               random_mode == CLASSIC_RANDOM ? "classic" :
-               random_mode == ENHANCED_RANDOM ? "enhanced" : "unknown",
-               color_mode == COLOR_MODE_1 ? "rgb" :
-               color_mode == COLOR_MODE_2 ? "enhanced" :
-               color_mode == COLOR_MODE_MONO ? "mono" : "unknown");
-        
-        // Initialize video encoder
-        VideoContext* video_ctx = init_video_encoder(
-            output_config.output_filename, 
-            Width, Height, 
-            output_config.framerate
-        );
-        
-        if (!video_ctx) {
-            fprintf(stderr, "Failed to initialize video encoder\n");
-            exit(1);
-        }
+               pattern_type_name(pattern_type), random_mode_name(random_mode), color_mode_name(color_mode));
         
         // Calculate total frames
         int total_frames = output_config.duration_seconds * output_config.framerate;
-        video_ctx->total_frames = total_frames;
-        video_ctx->start_time = get_current_time();
         
-        // Generate and encode frames
-        float time_offset = 0.0f;
-        float time_step = 0.05f;  // Match the real-time animation speed
+        if (output_config.rendition_count > 0) {
+            if (checkpoint_frames > 0 || resume_render || farm_coordinator_address) {
+                printf("Renditions cannot be combined with --checkpoint, --resume or --coordinator.\n");
+                exit(1);
+            }
+            int result = render_video_renditions(output_config.output_filename, total_frames,
+                                                 output_config.framerate);
+            if (result == 0) {
+                printf("Video generation complete\n");
+            }
+            cleanup();
+            exit(result);
+        }
+        
+        if ((checkpoint_frames > 0 || resume_render) && farm_coordinator_address) {
+            printf("--checkpoint and --resume cannot be combined with --coordinator.\n");
+            exit(1);
+        }
+        if (checkpoint_frames > 0 || resume_render) {
+            if (checkpoint_frames <= 0) checkpoint_frames = VIDEO_GOP_SIZE * 10;
+            int result = render_video_checkpointed(output_config.output_filename, total_frames,
+                                                   output_config.framerate);
+            if (result == 0) {
+                printf("Video generation complete: %s\n", output_config.output_filename);
+                print_stage_report();
+            }
+            cleanup();
+            exit(result);
+        }
         
-        for (int frame = 0; frame < total_frames; frame++) {
-            // Generate frame with current time offset
-            clearScreen();
-            generateArt(randseed, pattern_type, time_offset);
-            
-            // Draw textured quad
-            glBindTexture(GL_TEXTURE_2D, texture_id);
-            glBegin(GL_QUADS);
-            glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
-            glTexCoord2f(1.0f, 0.0f); glVertex2f(Width, 0.0f);
-            glTexCoord2f(1.0f, 1.0f); glVertex2f(Width, Height);
-            glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, Height);
-            glEnd();
-            
-            // Make sure rendering is complete
-            glFinish();
-            
-            // Read pixels and encode frame
-            read_pixels_to_buffer(video_ctx->frame_buffer, Width, Height);
-            if (encode_frame(video_ctx, video_ctx->frame_buffer) < 0) {
-                fprintf(stderr, "Error encoding frame %d\n", frame);
-                break;
+        if (farm_coordinator_address) {
+            int result = run_farm_coordinator(farm_coordinator_address, output_config.output_filename,
+                                              total_frames, output_config.framerate, argv[0]);
+            if (result == 0) {
+                printf("Video generation complete: %s\n", output_config.output_filename);
             }
-            
-            // Update progress and time offset
-            print_progress(frame + 1, total_frames, video_ctx->start_time);
-            video_ctx->frame_count++;
-            time_offset += time_step;
+            cleanup();
+            exit(result);
+        }
+        
+        // Open the encoder in the background while the first frames render
+        EncoderOpen pending;
+        encoder_open_start(&pending, output_config.output_filename, Width, Height,
+                           output_config.framerate, total_frames);
+        
+        // Generate and encode frames straight from the rendered frame buffer
+        render_video_range(NULL, &pending, 0, total_frames, true);
+        VideoContext* video_ctx = encoder_open_wait(&pending);
+        if (!video_ctx) {
+            exit(1);
         }
         
         printf("\nFinishing video encoding...\n");
         finalize_video_encoder(video_ctx);
         printf("Video generation complete: %s\n", output_config.output_filename);
+        print_stage_report();
         
         cleanup();
         exit(0);
     } else {
+        // Only real-time mode needs a window; video modes render and encode without GL
+        initGL(Width, Height, argc, argv);
+        timing_mark("GL window created");
+        
         // Register callbacks for real-time mode
         glutDisplayFunc(display);
         glutKeyboardFunc(keyboard);